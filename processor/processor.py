@@ -1,21 +1,29 @@
 import os
+import re
 import json
+import heapq
+import socket
+import struct
 import time
 import logging
 import threading
 from datetime import datetime, timedelta
-from collections import defaultdict, deque
+from collections import Counter, defaultdict, deque
 import dash
-from dash import dcc, html, Input, Output
+from dash import dcc, html, dash_table, Input, Output
 import plotly.graph_objs as go
 import plotly.express as px
 import zmq
 
-# Global data storage for sensor readings
-sensor_data = defaultdict(lambda: {
+from series_index import SeriesIndex, SeverityOrder
+
+# Label index over every series seen so far; a series is one metric of one sensor on one host
+series_index = SeriesIndex()
+
+# Global data storage for series readings, keyed by series id
+series_data = defaultdict(lambda: {
     'timestamps': deque(maxlen=100),
-    'cpu_usage': deque(maxlen=100),
-    'disk_usage': deque(maxlen=100),
+    'values': deque(maxlen=100),
     'status': 'Unknown',
     'last_update': None,
     'corruption_count': 0,
@@ -23,6 +31,213 @@ sensor_data = defaultdict(lambda: {
     'data_consistent': True
 })
 
+# Number of series currently in each status, maintained on ingest so the
+# dashboard never has to walk every series to draw the status chart
+status_counts = Counter()
+
+# Every series with data, worst first, so an unfiltered grid page costs O(page) rather than O(series)
+series_order = SeverityOrder()
+
+# Message keys that describe the reading rather than carry a metric value
+RESERVED_KEYS = {'sensor_id', 'timestamp', 'data_consistent', 'host', 'labels', 'delta', 'sampled_at'}
+DEFAULT_HOST = 'sensor'
+ALERT_THRESHOLD_PERCENT = 80
+INDEX_STATS_EVERY = 1000
+
+# Labels for sensors that predate the label model and only send a sensor_id
+LEGACY_SENSOR_LABELS = {
+    'cpu_usage_01': {'cpu': 'all'},
+    'disk_usage_root': {'mount': '/'},
+}
+
+def message_labels(message):
+    """Labels shared by every series carried in one message."""
+    sensor_id = message["sensor_id"]
+    labels = dict(LEGACY_SENSOR_LABELS.get(sensor_id, {}))
+    labels.update(message.get("labels") or {})
+    labels['host'] = message.get("host", DEFAULT_HOST)
+    labels['sensor'] = sensor_id
+    return labels
+
+def metric_fields(message):
+    for key, value in message.items():
+        if key not in RESERVED_KEYS and isinstance(value, (int, float)) and not isinstance(value, bool):
+            yield key, value
+
+def series_status(metric, value):
+    if metric.endswith('_percent'):
+        return "ALERT" if value > ALERT_THRESHOLD_PERCENT else "OK"
+    return "OK"
+
+# Readings arrive from both the ZMQ and the UDP receiver threads
+ingest_lock = threading.Lock()
+
+def ingest_message(message):
+    """Store every metric of a message under its series; returns the worst status seen."""
+    with ingest_lock:
+        return ingest_message_locked(message)
+
+# Agents in COUNTER_MODE=raw send cumulative counters ("<name>_total") stamped with
+# "sampled_at"; their rates are computed here from the stored samples, so a lost
+# message only widens one interval instead of losing it
+COUNTER_RATE_WINDOW_S = float(os.environ.get("COUNTER_RATE_WINDOW_S", "0"))
+COUNTER_HISTORY = 600
+# How far "sampled_at" has to go back to count as a reboot of the agent's host
+# (its monotonic clock restarting) rather than a late or reordered message
+COUNTER_RESET_JUMP_S = float(os.environ.get("COUNTER_RESET_JUMP_S", "60"))
+
+# Per counter series: (sampled_at, value) pairs, oldest first
+counter_samples = defaultdict(lambda: deque(maxlen=COUNTER_HISTORY))
+
+def counter_increase(prev, cur):
+    """Increase of a monotonic counter between two samples, across resets.
+
+    Every raw counter the agent sends is 64 bits wide, so a drop is a reset
+    (reboot, driver reload), never a wrap: the counter counts up from zero again.
+    """
+    if cur >= prev:
+        return cur - prev
+    return cur
+
+def counter_rate(samples, window_s=0):
+    """Per-second rate over the samples of the last window_s seconds; at least the last interval."""
+    if len(samples) < 2:
+        return None
+    end_time = samples[-1][0]
+    first = len(samples) - 2
+    while first > 0 and end_time - samples[first - 1][0] <= window_s:
+        first -= 1
+    elapsed = end_time - samples[first][0]
+    if elapsed <= 0:
+        return None
+    increase = sum(counter_increase(samples[i][1], samples[i + 1][1]) for i in range(first, len(samples) - 1))
+    return increase / elapsed
+
+def counter_metrics(sids_by_metric):
+    """Rates for the counters of one raw message, plus CPU shares from the jiffies counters."""
+    derived = []
+    jiffies = {}
+    for metric, sid in sids_by_metric.items():
+        samples = counter_samples[sid]
+        rate = counter_rate(samples, COUNTER_RATE_WINDOW_S)
+        if rate is None:
+            continue
+        if metric.startswith('cpu_') and metric.endswith('_jiffies_total'):
+            jiffies[metric[len('cpu_'):-len('_jiffies_total')]] = counter_increase(samples[-2][1], samples[-1][1])
+        else:
+            derived.append((metric[:-len('_total')] + '_per_sec', rate))
+    total = sum(jiffies.values())
+    if total > 0:
+        # Same shares the agent reports in rates mode: every category but idle
+        for category, ticks in jiffies.items():
+            if category != 'idle':
+                derived.append((f"cpu_{category}_percent", ticks / total * 100.0))
+    return derived
+
+def store_point(labels, metric, value, timestamp, data_consistent):
+    """Append one value to its series; returns the series id and its status."""
+    labels['metric'] = metric
+    sid = series_index.series_id(labels)
+    data = series_data[sid]
+    data['timestamps'].append(timestamp)
+    data['values'].append(value)
+    data['last_update'] = timestamp
+    data['total_readings'] += 1
+    data['data_consistent'] = data_consistent
+    if not data_consistent:
+        data['corruption_count'] += 1
+    status = series_status(metric, value)
+    if status != data['status']:
+        if data['status'] in status_counts:
+            status_counts[data['status']] -= 1
+        status_counts[status] += 1
+        data['status'] = status
+    series_order.update(sid, severity_key(sid))
+    return sid, data['status']
+
+def ingest_message_locked(message):
+    labels = message_labels(message)
+    timestamp = datetime.now()
+    data_consistent = message.get("data_consistent", True)
+    if not data_consistent:
+        logging.warning(f"Data corruption detected for sensor {labels['sensor']} on {labels['host']}")
+
+    sampled_at = message.get("sampled_at")
+    counters = {}
+    worst = "OK"
+    for metric, value in metric_fields(message):
+        sid, status = store_point(labels, metric, value, timestamp, data_consistent)
+        if sampled_at is not None and metric.endswith('_total'):
+            samples = counter_samples[sid]
+            if samples and sampled_at < samples[-1][0] - COUNTER_RESET_JUMP_S:
+                samples.clear()   # the agent's monotonic clock went back: its host rebooted, start over
+            # A late or replayed sample is dropped; the counter is cumulative, so the next one covers it
+            if not samples or sampled_at > samples[-1][0]:
+                samples.append((sampled_at, value))
+                counters[metric] = sid
+        if status == "ALERT":
+            worst = "ALERT"
+    for metric, value in counter_metrics(counters):
+        if store_point(labels, metric, value, timestamp, data_consistent)[1] == "ALERT":
+            worst = "ALERT"
+    return worst
+
+# Sensors shown on the dashboard, per host; the reply to each agent batch leases
+# them back so agents running with LAZY_SAMPLING sample only what is watched
+SUBSCRIPTION_LEASE_S = int(os.environ.get("SUBSCRIPTION_LEASE_S", "30"))
+subscription_lock = threading.Lock()
+watched_sensors = defaultdict(dict)   # host -> {sensor glob: monotonic time of last interest}
+
+def note_watched(host, sensor):
+    with subscription_lock:
+        watched_sensors[host][sensor] = time.monotonic()
+
+def subscriptions_for(host):
+    """Leases for every sensor of host watched within the lease period."""
+    now = time.monotonic()
+    with subscription_lock:
+        sensors = watched_sensors.get(host)
+        if not sensors:
+            return []
+        for sensor in [s for s, seen in sensors.items() if now - seen >= SUBSCRIPTION_LEASE_S]:
+            del sensors[sensor]
+        return [{"sensor": sensor, "lease_s": SUBSCRIPTION_LEASE_S} for sensor in sensors]
+
+# Wide readings arrive delta-encoded ("delta": {"seq", "keyframe"}): per (host, sensor)
+# the last sequence number and the full value set the deltas apply to
+delta_streams = {}
+delta_stats = Counter()
+
+def decode_delta(message):
+    """Full reading for a delta-encoded one; None while its stream waits for a keyframe."""
+    delta = message.get("delta")
+    if not isinstance(delta, dict):
+        return message
+    key = (message.get("host", DEFAULT_HOST), message["sensor_id"])
+    if delta.get("keyframe"):
+        stream = delta_streams[key] = {"seq": delta.get("seq"), "values": dict(metric_fields(message))}
+        delta_stats['keyframes'] += 1
+    else:
+        stream = delta_streams.get(key)
+        if stream is None or delta.get("seq") != stream["seq"] + 1:
+            # Something in between was lost, so the state is unknown until the agent sends a keyframe
+            if stream is not None:
+                logging.warning(f"Delta gap for {key[1]} on {key[0]}: expected {stream['seq'] + 1}, got {delta.get('seq')}")
+                del delta_streams[key]
+            delta_stats['dropped'] += 1
+            return None
+        stream["seq"] = delta["seq"]
+        stream["values"].update(metric_fields(message))
+        delta_stats['deltas'] += 1
+    full = {k: v for k, v in message.items() if k in RESERVED_KEYS and k != 'delta'}
+    full.update(stream["values"])
+    return full
+
+def series_name(sid):
+    labels = series_index.labels_of(sid)
+    name = f"{labels.get('host', DEFAULT_HOST)}/{labels.get('sensor')}"
+    return name if labels.get('metric') in (None, '') else f"{name}:{labels['metric']}"
+
 def process_incoming_data():
     logging.info("Starting incoming data processor...")
 
@@ -39,44 +254,49 @@ def process_incoming_data():
         logging.error(f"Failed to establish connection: {e}")
         return
 
+    messages_seen = 0
+    next_index_stats = INDEX_STATS_EVERY
     while True:
         try:
-            # Receive JSON from ZeroMQ (no data/buffer)
+            # Receive JSON from ZeroMQ (no data/buffer); agents may batch readings in an array
             message = server.recv_json()
             logging.info(f"Received message: {message}")
+            if isinstance(message, dict) and message.get("control") == "transport_stats":
+                # Benchmark tools ask how much arrived over the fire-and-forget transports
+                server.send_json({"udp": udp_totals()})
+                continue
+            if isinstance(message, dict) and message.get("control") == "subscribe":
+                # Consumers other than the dashboard ask for full-rate sampling explicitly
+                note_watched(message.get("host", DEFAULT_HOST), message.get("sensor", "*"))
+                server.send_json({"status": "OK"})
+                continue
+            readings = message if isinstance(message, list) else [message]
+            messages_seen += len(readings)
 
-            # Store data for dashboard
-            sensor_id = message["sensor_id"]
-            timestamp = datetime.now()
+            status = "OK"
+            for reading in readings:
+                reading = decode_delta(reading)
+                if reading is not None and ingest_message(reading) == "ALERT":
+                    status = "ALERT"
 
-            sensor_data[sensor_id]['timestamps'].append(timestamp)
-            sensor_data[sensor_id]['last_update'] = timestamp
-            sensor_data[sensor_id]['total_readings'] += 1
-
-            # Check for data consistency
-            data_consistent = message.get("data_consistent", True)
-            sensor_data[sensor_id]['data_consistent'] = data_consistent
-
-            if not data_consistent:
-                sensor_data[sensor_id]['corruption_count'] += 1
-                logging.warning(f"Data corruption detected for sensor {sensor_id}")
-
-            # Handle different sensor types
-            if "cpu_usage_percent" in message:
-                cpu_usage = message.get("cpu_usage_percent", 0)
-                sensor_data[sensor_id]['cpu_usage'].append(cpu_usage)
-                sensor_data[sensor_id]['status'] = "ALERT" if cpu_usage > 80 else "OK"
-            elif "disk_usage_percent" in message:
-                disk_usage = message.get("disk_usage_percent", 0)
-                sensor_data[sensor_id]['disk_usage'].append(disk_usage)
-                sensor_data[sensor_id]['status'] = "ALERT" if disk_usage > 80 else "OK"
+            if messages_seen >= next_index_stats:
+                next_index_stats = messages_seen + INDEX_STATS_EVERY
+                stats = series_index.memory_stats()
+                logging.info(f"Series index: {stats['series']} series, {stats['label_pairs']} label pairs, "
+                             f"{stats['bytes_total']} B ({stats['bytes_per_series']:.0f} B/series)")
+                if delta_streams:
+                    logging.info(f"Delta streams: {len(delta_streams)}, {delta_stats['keyframes']} keyframes, "
+                                 f"{delta_stats['deltas']} deltas, {delta_stats['dropped']} dropped")
 
             # Send response back via ZMQ
             response = {
-                "sensor_id": sensor_id,
+                "sensor_id": readings[0]["sensor_id"] if readings else "",
                 "timestamp": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
-                "status": sensor_data[sensor_id]['status']
+                "status": status
             }
+            subscriptions = subscriptions_for(readings[0].get("host", DEFAULT_HOST)) if readings else []
+            if subscriptions:
+                response["subscriptions"] = subscriptions
             server.send_json(response)
 
         except Exception as e:
@@ -88,14 +308,290 @@ def process_incoming_data():
     except Exception as e:
         logging.error(f"Error cleaning up connection: {e}")
 
+UDP_PORT = int(os.environ.get("UDP_PORT", "5556"))
+UDP_BATCH = 256
+UDP_MAX_DATAGRAM = 65535
+UDP_HEADER = struct.Struct('!IHHIQ')   # magic, version, record count, stream id, sequence
+UDP_MAGIC = 0x544C5531                 # "TLU1"
+UDP_STATS_INTERVAL = 5
+
+# Per sender stream: sequence tracking for fire-and-forget datagrams
+udp_streams = {}
+udp_lock = threading.Lock()
+
+def udp_totals():
+    with udp_lock:
+        return {
+            'streams': len(udp_streams),
+            'datagrams': sum(s['received'] for s in udp_streams.values()),
+            'records': sum(s['records'] for s in udp_streams.values()),
+            'lost': sum(s['lost'] for s in udp_streams.values()),
+            'late': sum(s['late'] for s in udp_streams.values()),
+        }
+
+def track_udp_sequence(key, seq, records):
+    """Update loss accounting for one datagram of a stream; returns the stream record."""
+    with udp_lock:
+        stream = udp_streams.get(key)
+        if stream is None:
+            stream = udp_streams[key] = {'expected': seq, 'received': 0, 'records': 0, 'lost': 0, 'late': 0, 'host': None}
+        if seq >= stream['expected']:
+            stream['lost'] += seq - stream['expected']
+            stream['expected'] = seq + 1
+        else:
+            # A datagram counted as lost arrived after all (reordered)
+            stream['late'] += 1
+            stream['lost'] = max(0, stream['lost'] - 1)
+        stream['received'] += 1
+        stream['records'] += records
+        return stream
+
+def handle_udp_datagram(view, addr):
+    if len(view) < UDP_HEADER.size:
+        return
+    magic, version, count, stream_id, seq = UDP_HEADER.unpack_from(view)
+    if magic != UDP_MAGIC or version != 1:
+        return
+    stream = track_udp_sequence((addr, stream_id), seq, count)
+    for record in bytes(view[UDP_HEADER.size:]).split(b'\n'):
+        try:
+            message = json.loads(record)
+        except ValueError:
+            continue
+        stream['host'] = message.get("host", DEFAULT_HOST)
+        ingest_message(message)
+
+def report_udp_loss():
+    """Log per-stream loss and store it as transport_udp series of the sending host."""
+    with udp_lock:
+        streams = [(key, dict(stream)) for key, stream in udp_streams.items()]
+    for (addr, stream_id), stream in streams:
+        if stream['host'] is None:
+            continue
+        sent = stream['received'] + stream['lost']
+        loss = stream['lost'] / sent * 100 if sent else 0.0
+        logging.info(f"UDP stream {stream_id:08x} from {addr[0]} ({stream['host']}): {stream['received']} datagrams, "
+                     f"{stream['lost']} lost ({loss:.2f}%), {stream['late']} late")
+        ingest_message({
+            'sensor_id': 'transport_udp',
+            'host': stream['host'],
+            'labels': {'stream': f"{stream_id:08x}"},
+            'datagrams_received': stream['received'],
+            'datagrams_lost': stream['lost'],
+            'loss_percent': loss,
+        })
+
+def process_udp_datagrams():
+    """Receive fire-and-forget datagrams; after each wake-up, drain up to UDP_BATCH more without blocking."""
+    logging.info(f"Starting UDP receiver on port {UDP_PORT}...")
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 8 * 1024 * 1024)
+    sock.bind(("0.0.0.0", UDP_PORT))
+    sock.settimeout(1.0)
+    buffers = [bytearray(UDP_MAX_DATAGRAM) for _ in range(UDP_BATCH)]
+    views = [memoryview(buf) for buf in buffers]
+    next_report = time.monotonic() + UDP_STATS_INTERVAL
+
+    while True:
+        batch = []
+        try:
+            sock.settimeout(1.0)
+            nbytes, addr = sock.recvfrom_into(buffers[0])
+            batch.append((views[0][:nbytes], addr))
+            sock.setblocking(False)
+            while len(batch) < UDP_BATCH:
+                nbytes, addr = sock.recvfrom_into(buffers[len(batch)])
+                batch.append((views[len(batch)][:nbytes], addr))
+        except (BlockingIOError, socket.timeout):
+            pass
+        except Exception as e:
+            logging.error(f"UDP receive error: {e}")
+
+        for view, addr in batch:
+            try:
+                handle_udp_datagram(view, addr)
+            except Exception as e:
+                logging.error(f"Bad UDP datagram from {addr}: {e}")
+
+        if time.monotonic() >= next_report:
+            next_report = time.monotonic() + UDP_STATS_INTERVAL
+            report_udp_loss()
+
+# Columns computed from series data rather than labels; filters on these cannot use the index
+GRID_DATA_COLUMNS = {'series', 'value', 'status', 'corruption_count', 'total_readings', 'last_update'}
+GRID_PAGE_SIZE = 25
+TREND_SERIES_LIMIT = 10
+
+FILTER_PATTERN = re.compile(r'\{(?P<column>[^}]+)\}\s*[si]?(?P<op>contains|eq|ne|lt|le|gt|ge|!=|<=|>=|=|<|>)\s*(?P<value>.*)')
+FILTER_OPERATORS = {'=': 'eq', '!=': 'ne', '<': 'lt', '<=': 'le', '>': 'gt', '>=': 'ge'}
+
+def parse_filter_query(filter_query):
+    """Split a DataTable filter_query into (column, op, value) terms."""
+    terms = []
+    for part in (filter_query or '').split(' && '):
+        match = FILTER_PATTERN.match(part.strip())
+        if not match:
+            continue
+        value = match.group('value').strip()
+        if len(value) > 1 and value[0] == value[-1] and value[0] in ('"', "'", '`'):
+            value = value[1:-1]
+        else:
+            try:
+                value = float(value)
+            except ValueError:
+                pass
+        op = match.group('op')
+        terms.append((match.group('column'), FILTER_OPERATORS.get(op, op), value))
+    return terms
+
+def series_row_value(sid, column):
+    data = series_data[sid]
+    if column == 'value':
+        return data['values'][-1] if data['values'] else None
+    if column in ('status', 'corruption_count', 'total_readings'):
+        return data[column]
+    if column == 'last_update':
+        return data['last_update'].strftime('%H:%M:%S') if data['last_update'] else ''
+    if column == 'series':
+        return series_name(sid)
+    return series_index.label(sid, column, '')
+
+def matches_term(actual, op, wanted):
+    if actual is None:
+        return False
+    if op == 'contains':
+        return str(wanted) in str(actual)
+    if isinstance(wanted, float) and not isinstance(actual, (int, float)):
+        return False
+    if not isinstance(wanted, float):
+        actual = str(actual)
+    return {'eq': actual == wanted, 'ne': actual != wanted, 'lt': actual < wanted,
+            'le': actual <= wanted, 'gt': actual > wanted, 'ge': actual >= wanted}[op]
+
+def severity_key(sid):
+    """Sort key that puts the worst series first: alerts, then corruption, then highest value."""
+    data = series_data[sid]
+    value = data['values'][-1] if data['values'] else float('-inf')
+    return (data['status'] != 'ALERT', data['corruption_count'] == 0, -value)
+
+def query_series_page(filter_query, sort_by, page_current, page_size):
+    """Select, order and slice the series grid on the server.
+
+    Label equality terms resolve through the series index; the remaining terms
+    only look at that candidate set, and ordering uses a bounded heap so only
+    the rows up to the requested page are ever materialised. The default view
+    (no filter, no sort) reads the first rows straight off series_order.
+    Returns (rows, matching series count, series ids on the page).
+    """
+    matchers, predicates = {}, []
+    for column, op, value in parse_filter_query(filter_query):
+        if op == 'eq' and column not in GRID_DATA_COLUMNS:
+            matchers[column] = str(value) if not isinstance(value, float) else f"{value:g}"
+        else:
+            predicates.append((column, op, value))
+
+    wanted = (page_current + 1) * page_size
+    if not matchers and not predicates and not sort_by:
+        page_sids = series_order.first(wanted)[page_current * page_size:]
+        return grid_rows(page_sids), len(series_order), page_sids
+
+    candidates = series_index.select(matchers)
+    candidates = [sid for sid in candidates if sid in series_data and series_data[sid]['timestamps']]
+    for column, op, value in predicates:
+        candidates = [sid for sid in candidates if matches_term(series_row_value(sid, column), op, value)]
+
+    if sort_by:
+        column, descending = sort_by[0]['column_id'], sort_by[0]['direction'] == 'desc'
+        def key(sid):
+            value = series_row_value(sid, column)
+            return (value is None, value if value is not None else 0)
+        select = heapq.nlargest if descending else heapq.nsmallest
+        ordered = select(wanted, candidates, key=key)
+    else:
+        ordered = heapq.nsmallest(wanted, candidates, key=severity_key)
+
+    page_sids = ordered[page_current * page_size:wanted]
+    return grid_rows(page_sids), len(candidates), page_sids
+
+def grid_rows(page_sids):
+    rows = []
+    for sid in page_sids:
+        data = series_data[sid]
+        labels = series_index.labels_of(sid)
+        value = data['values'][-1] if data['values'] else None
+        rows.append({
+            'series': series_name(sid),
+            'host': labels.get('host', ''),
+            'sensor': labels.get('sensor', ''),
+            'metric': labels.get('metric', ''),
+            'value': round(value, 2) if isinstance(value, float) else value,
+            'status': data['status'],
+            'corruption_count': data['corruption_count'],
+            'total_readings': data['total_readings'],
+            'last_update': data['last_update'].strftime('%H:%M:%S') if data['last_update'] else '',
+        })
+    return rows
+
+def trend_figure(sids, title, yaxis_title):
+    fig = go.Figure()
+    for sid in sids[:TREND_SERIES_LIMIT]:
+        data = series_data[sid]
+        if data['values']:
+            fig.add_trace(go.Scatter(
+                x=list(data['timestamps']),
+                y=list(data['values']),
+                mode='lines+markers',
+                name=f'Sensor {series_name(sid)}',
+                line=dict(width=2)
+            ))
+    fig.update_layout(
+        title=title,
+        xaxis_title="Time",
+        yaxis_title=yaxis_title,
+        hovermode='closest'
+    )
+    return fig
+
 def create_dash_app():
     """Create and configure the Dash application"""
     app = dash.Dash(__name__)
     
+    grid_columns = [
+        {'name': 'Series', 'id': 'series'},
+        {'name': 'Host', 'id': 'host'},
+        {'name': 'Sensor', 'id': 'sensor'},
+        {'name': 'Metric', 'id': 'metric'},
+        {'name': 'Value', 'id': 'value', 'type': 'numeric'},
+        {'name': 'Status', 'id': 'status'},
+        {'name': 'Corruptions', 'id': 'corruption_count', 'type': 'numeric'},
+        {'name': 'Readings', 'id': 'total_readings', 'type': 'numeric'},
+        {'name': 'Last Update', 'id': 'last_update'},
+    ]
+    
     app.layout = html.Div([
         html.H1("Gita Linux Expert Software Developer Exercise", style={'textAlign': 'center', 'marginBottom': 30}),
         
-        html.Div(id='sensor-cards', style={'marginBottom': 30}),
+        html.Div(id='grid-summary', style={'marginBottom': 10}),
+        
+        # Sensor grid: paging, filtering and sorting all happen server side so
+        # only the visible page is serialised on every refresh
+        dash_table.DataTable(
+            id='sensor-grid',
+            columns=grid_columns,
+            page_current=0,
+            page_size=GRID_PAGE_SIZE,
+            page_action='custom',
+            filter_action='custom',
+            filter_query='',
+            sort_action='custom',
+            sort_mode='single',
+            sort_by=[],
+            style_data_conditional=[
+                {'if': {'filter_query': '{corruption_count} > 0'}, 'backgroundColor': '#ffe0b3'},
+                {'if': {'filter_query': '{status} = "ALERT"'}, 'backgroundColor': '#ffcccc'},
+            ],
+            style_table={'marginBottom': 30},
+        ),
         
         html.Div([
             html.Div([
@@ -123,112 +619,49 @@ def create_dash_app():
     ], style={'padding': '20px'})
     
     @app.callback(
-        [Output('sensor-cards', 'children'),
+        [Output('sensor-grid', 'data'),
+         Output('sensor-grid', 'page_count'),
+         Output('grid-summary', 'children'),
          Output('cpu-usage-graph', 'figure'),
          Output('disk-usage-graph', 'figure'),
          Output('status-pie-chart', 'figure')],
-        [Input('interval-component', 'n_intervals')]
+        [Input('interval-component', 'n_intervals'),
+         Input('sensor-grid', 'page_current'),
+         Input('sensor-grid', 'page_size'),
+         Input('sensor-grid', 'sort_by'),
+         Input('sensor-grid', 'filter_query')]
     )
-    def update_dashboard(n):
-        # Create sensor cards
-        cards = []
-        for sensor_id, data in sensor_data.items():
-            if data['timestamps']:
-                status = data['status']
-                last_update = data['last_update']
-                corruption_rate = (data['corruption_count'] / data['total_readings'] * 100) if data['total_readings'] > 0 else 0
-                
-                # Determine card color based on corruption and status
-                if data['corruption_count'] > 0:
-                    card_color = '#ff8800'  # Orange for corruption
-                elif status == 'ALERT':
-                    card_color = '#ff4444'  # Red for alerts
-                else:
-                    card_color = '#44ff44'  # Green for OK
-                
-                if sensor_id.startswith('cpu'):
-                    current_value = data['cpu_usage'][-1] if data['cpu_usage'] else 'N/A'
-                    value_text = f"CPU Usage: {current_value}%"
-                else:
-                    current_value = data['disk_usage'][-1] if data['disk_usage'] else 'N/A'
-                    value_text = f"Disk Usage: {current_value}%"
-                
-                card = html.Div([
-                    html.H4(f"Sensor {sensor_id}"),
-                    html.P(value_text, style={'fontSize': '20px', 'fontWeight': 'bold'}),
-                    html.P(f"Status: {status}"),
-                    html.P(f"Corruption: {data['corruption_count']}/{data['total_readings']} ({corruption_rate:.1f}%)", 
-                           style={'color': 'red' if data['corruption_count'] > 0 else 'green'}),
-                    html.P(f"Last Update: {last_update.strftime('%H:%M:%S') if last_update else 'N/A'}")
-                ], style={
-                    'border': f'2px solid {card_color}',
-                    'borderRadius': '10px',
-                    'padding': '15px',
-                    'margin': '10px',
-                    'backgroundColor': '#f9f9f9',
-                    'display': 'inline-block',
-                    'minWidth': '250px'
-                })
-                cards.append(card)
-        logging.info("creating CPU usage trend graph")
-        # Create CPU usage trend graph
-        fig_cpu = go.Figure()
-        for sensor_id, data in sensor_data.items():
-            if data['cpu_usage'] and sensor_id.startswith('cpu'):
-                fig_cpu.add_trace(go.Scatter(
-                    x=list(data['timestamps']),
-                    y=list(data['cpu_usage']),
-                    mode='lines+markers',
-                    name=f'Sensor {sensor_id}',
-                    line=dict(width=2)
-                ))
+    def update_dashboard(n, page_current, page_size, sort_by, filter_query):
+        started = time.perf_counter()
+        page_current = page_current or 0
+        page_size = page_size or GRID_PAGE_SIZE
+        rows, matching, page_sids = query_series_page(filter_query, sort_by, page_current, page_size)
+        page_count = max(1, -(-matching // page_size))
+        summary = f"{matching} of {len(series_index)} series match, page {page_current + 1}/{page_count}"
+        for sid in page_sids:
+            note_watched(series_index.label(sid, 'host'), series_index.label(sid, 'sensor'))
         
-        fig_cpu.update_layout(
-            title="CPU Usage Over Time",
-            xaxis_title="Time",
-            yaxis_title="CPU Usage (%)",
-            hovermode='closest'
-        )
+        # Trend graphs follow the visible page rather than every series
+        logging.info("creating CPU usage trend graph")
+        cpu_sids = [sid for sid in page_sids if series_index.label(sid, 'metric') == 'cpu_usage_percent']
+        fig_cpu = trend_figure(cpu_sids, "CPU Usage Over Time", "CPU Usage (%)")
         logging.info("creating disk usage trend graph")
-        # Create disk usage trend graph
-        fig_disk = go.Figure()
-        for sensor_id, data in sensor_data.items():
-            if data['disk_usage'] and sensor_id.startswith('disk'):
-                fig_disk.add_trace(go.Scatter(
-                    x=list(data['timestamps']),
-                    y=list(data['disk_usage']),
-                    mode='lines+markers',
-                    name=f'Sensor {sensor_id}',
-                    line=dict(width=2)
-                ))
+        disk_sids = [sid for sid in page_sids if series_index.label(sid, 'metric') == 'disk_usage_percent']
+        fig_disk = trend_figure(disk_sids, "Disk Usage Over Time", "Disk Usage (%)")
         
-        fig_disk.update_layout(
-            title="Disk Usage Over Time",
-            xaxis_title="Time",
-            yaxis_title="Disk Usage (%)",
-            hovermode='closest'
-        )
         logging.info("creating pie chart for sensor status")
-        # Create status pie chart
-        status_counts = {'OK': 0, 'ALERT': 0}
-        for data in sensor_data.values():
-            if data['status'] in status_counts:
-                status_counts[data['status']] += 1
-        
         fig_pie = px.pie(
-            values=list(status_counts.values()),
-            names=list(status_counts.keys()),
+            values=[status_counts['OK'], status_counts['ALERT']],
+            names=['OK', 'ALERT'],
             title="Sensor Status Distribution",
             color_discrete_map={'OK': '#44ff44', 'ALERT': '#ff4444'}
         )
-        logging.info("returning updated layout with sensor data")
-        logging.info(f"Dashboard update data: cards={len(cards)}, cpu_traces={len(fig_cpu.data)}, disk_traces={len(fig_disk.data)}, status_counts={status_counts}")
-        for i, card_data in enumerate(cards):
-            logging.debug(f"Card {i}: {card_data}")
-        logging.debug(f"CPU figure data: {fig_cpu.data}")
-        logging.debug(f"Disk figure data: {fig_disk.data}")
-        logging.debug(f"Pie chart data: {fig_pie.data}")
-        return cards, fig_cpu, fig_disk, fig_pie
+        elapsed_ms = (time.perf_counter() - started) * 1000
+        logging.info(f"Dashboard update data: rows={len(rows)}, matching={matching}, series={len(series_index)}, "
+                     f"status_counts={dict(status_counts)}, took {elapsed_ms:.1f} ms")
+        for i, row in enumerate(rows):
+            logging.debug(f"Row {i}: {row}")
+        return rows, page_count, summary, fig_cpu, fig_disk, fig_pie
     logging.info("nothing to update, returning existing layout")
     return app
 
@@ -237,6 +670,7 @@ def main():
     
     
     threading.Thread(target=process_incoming_data, daemon=True).start()
+    threading.Thread(target=process_udp_datagrams, daemon=True).start()
     
     # Create and run Dash app
     app = create_dash_app()
@@ -0,0 +1,176 @@
+import heapq
+import sys
+import threading
+
+
+class LabelInterner:
+    """Maps (label name, label value) pairs to small integer ids and back."""
+
+    def __init__(self):
+        self._ids = {}
+        self._pairs = []
+
+    def intern(self, name, value):
+        key = (name, value)
+        pair_id = self._ids.get(key)
+        if pair_id is None:
+            pair_id = len(self._pairs)
+            self._ids[key] = pair_id
+            self._pairs.append(key)
+        return pair_id
+
+    def lookup(self, name, value):
+        return self._ids.get((name, value))
+
+    def pair(self, pair_id):
+        return self._pairs[pair_id]
+
+    def __len__(self):
+        return len(self._pairs)
+
+
+class SeriesIndex:
+    """Series identified by label sets, with an inverted index from label pairs to series ids.
+
+    A series id is a dense integer assigned on first sight of a label set. Queries
+    intersect the posting sets of every matcher, smallest first, so selecting a
+    handful of series out of many never walks the whole series table.
+    """
+
+    def __init__(self):
+        self.labels = LabelInterner()
+        self._series_by_key = {}     # sorted tuple of pair ids -> series id
+        self._series_labels = []     # series id -> sorted tuple of pair ids
+        self._postings = {}          # pair id -> set of series ids
+        self._values_by_name = {}    # label name -> set of pair ids with that name
+        self._lock = threading.Lock()
+
+    def series_id(self, labels):
+        """Return the id for a label set, registering the series if it is new."""
+        with self._lock:
+            key = tuple(sorted(self.labels.intern(name, str(value)) for name, value in labels.items()))
+            sid = self._series_by_key.get(key)
+            if sid is not None:
+                return sid
+            sid = len(self._series_labels)
+            self._series_by_key[key] = sid
+            self._series_labels.append(key)
+            for pair_id in key:
+                postings = self._postings.get(pair_id)
+                if postings is None:
+                    postings = self._postings[pair_id] = set()
+                    self._values_by_name.setdefault(self.labels.pair(pair_id)[0], set()).add(pair_id)
+                postings.add(sid)
+            return sid
+
+    def labels_of(self, sid):
+        with self._lock:
+            return dict(self.labels.pair(pair_id) for pair_id in self._series_labels[sid])
+
+    def label(self, sid, name, default=None):
+        with self._lock:
+            for pair_id in self._series_labels[sid]:
+                pair_name, value = self.labels.pair(pair_id)
+                if pair_name == name:
+                    return value
+        return default
+
+    def select(self, matchers=None, **kwargs):
+        """Return the set of series ids matching every label matcher.
+
+        Matcher values may be a single string or a collection of strings; the
+        latter matches any of them (the union of their postings).
+        """
+        matchers = dict(matchers or {}, **kwargs)
+        with self._lock:
+            if not matchers:
+                return set(range(len(self._series_labels)))
+            candidates = []
+            for name, wanted in matchers.items():
+                values = [wanted] if isinstance(wanted, str) else wanted
+                postings = set()
+                for value in values:
+                    pair_id = self.labels.lookup(name, str(value))
+                    if pair_id is not None:
+                        postings |= self._postings[pair_id]
+                if not postings:
+                    return set()
+                candidates.append(postings)
+            candidates.sort(key=len)
+            return candidates[0].intersection(*candidates[1:])
+
+    def label_values(self, name):
+        with self._lock:
+            return sorted(self.labels.pair(pair_id)[1] for pair_id in self._values_by_name.get(name, ()))
+
+    def __len__(self):
+        return len(self._series_labels)
+
+    def memory_stats(self):
+        """Approximate bytes held by the index structures (not the per-series samples)."""
+        with self._lock:
+            size = sys.getsizeof
+            total = size(self.labels._ids) + size(self.labels._pairs)
+            for pair in self.labels._pairs:
+                total += size(pair) + size(pair[0]) + size(pair[1])
+            total += size(self._series_by_key) + size(self._series_labels)
+            for key in self._series_labels:
+                total += size(key)
+            total += size(self._postings)
+            for postings in self._postings.values():
+                total += size(postings)
+            total += size(self._values_by_name)
+            for pair_ids in self._values_by_name.values():
+                total += size(pair_ids)
+            series = len(self._series_labels)
+            return {
+                'series': series,
+                'label_pairs': len(self.labels),
+                'bytes_total': total,
+                'bytes_per_series': total / series if series else 0.0,
+            }
+
+
+class SeverityOrder:
+    """Series ids ordered by a sort key, readable first-k without sorting everything.
+
+    Every update pushes a fresh heap entry and leaves the series' previous one
+    stale; reads skip stale entries and the heap is rebuilt once they outnumber
+    the live ones, so an update is O(log n) amortised and reading the first k
+    ids walks O(k log k) heap nodes however many series there are.
+    """
+
+    def __init__(self):
+        self._heap = []      # (key, version, series id), stale unless version is current
+        self._live = {}      # series id -> (key, version)
+        self._version = 0
+        self._lock = threading.Lock()
+
+    def update(self, sid, key):
+        with self._lock:
+            live = self._live.get(sid)
+            if live is not None and live[0] == key:
+                return
+            self._version += 1
+            self._live[sid] = (key, self._version)
+            heapq.heappush(self._heap, (key, self._version, sid))
+            if len(self._heap) > 2 * len(self._live) + 64:
+                self._heap = [(key, version, sid) for sid, (key, version) in self._live.items()]
+                heapq.heapify(self._heap)
+
+    def first(self, count):
+        """The count series ids with the smallest keys, in order."""
+        with self._lock:
+            heap, result = self._heap, []
+            frontier = [(heap[0], 0)] if heap else []
+            while frontier and len(result) < count:
+                (key, version, sid), i = heapq.heappop(frontier)
+                if self._live[sid][1] == version:
+                    result.append(sid)
+                for child in (2 * i + 1, 2 * i + 2):
+                    if child < len(heap):
+                        heapq.heappush(frontier, (heap[child], child))
+            return result
+
+    def __len__(self):
+        return len(self._live)
@@ -0,0 +1,371 @@
+#pragma once
+
+// Per-container CPU, memory and IO from the cgroup v2 hierarchy. The tree is
+// walked once at start; after that an inotify watch on every directory
+// reports created and removed cgroups, so a tick never rescans the tree. Each
+// tracked cgroup keeps its stat files open and is re-read with pread, and the
+// cgroups are sampled as TaskPool tasks that each touch only their own entries.
+// Cost per tick is a handful of preads per container.
+//
+// Which cgroups count as containers is a list of fnmatch patterns
+// (CGROUP_INCLUDE): one without a '/' is matched against the last path
+// element, one with a '/' against the whole path below the root, '*' never
+// crossing a '/'. The default covers docker, containerd, CRI-O and podman
+// under both the systemd and cgroupfs drivers. Each one becomes a
+// "container_<id>" reading, with the id shortened to 12 characters like
+// `docker ps` does. The walk stops at a match: cgroups nested inside a
+// container (systemd's init.scope and the like) belong to it, not beside it.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "task_pool.hpp"
+#include "wire.hpp"
+
+inline const std::vector<std::string>& default_container_patterns() {
+    static const std::vector<std::string> patterns = {
+        "*docker-*.scope", "docker/*", "*cri-containerd-*.scope", "*crio-*.scope", "*libpod-*.scope",
+    };
+    return patterns;
+}
+
+// "system.slice/docker-4f3c...e1.scope" -> "4f3ce1a2b3c4"; anything else keeps its last path element.
+inline std::string container_id(const std::string& path) {
+    std::string name = path.substr(path.rfind('/') + 1);
+    if (name.size() > 6 && name.compare(name.size() - 6, 6, ".scope") == 0) name.resize(name.size() - 6);
+    size_t dash = name.rfind('-');
+    std::string id = dash == std::string::npos ? name : name.substr(dash + 1);
+    bool hex = id.size() == 64 && id.find_first_not_of("0123456789abcdef") == std::string::npos;
+    return hex ? id.substr(0, 12) : name;
+}
+
+struct CgroupSample {
+    std::chrono::steady_clock::time_point taken;
+    uint64_t cpu_usage_us = 0, cpu_user_us = 0, cpu_system_us = 0, throttled_us = 0;
+    uint64_t memory_bytes = 0, memory_anon = 0, memory_file = 0, oom_kills = 0;
+    uint64_t io_read_bytes = 0, io_write_bytes = 0, io_read_ops = 0, io_write_ops = 0;
+};
+
+// One tracked cgroup: its open stat files, the last sample and the reading built this tick.
+struct Cgroup {
+    enum File { cpu_stat, memory_current, memory_stat, memory_events, io_stat, kFiles };
+
+    std::string path;  // relative to the root
+    std::string sensor_id;
+    int fds[kFiles];
+    CgroupSample prev;
+    bool primed = false;
+    bool gone = false;
+    Reading reading;  // filled by the sampling task when it has one
+
+    Cgroup(int root_fd, std::string rel) : path(std::move(rel)), sensor_id("container_" + container_id(path)) {
+        static const char* const names[kFiles] = {"cpu.stat", "memory.current", "memory.stat", "memory.events", "io.stat"};
+        int dir = openat(root_fd, path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        for (int f = 0; f < kFiles; ++f) fds[f] = dir >= 0 ? openat(dir, names[f], O_RDONLY | O_CLOEXEC) : -1;
+        if (dir >= 0) close(dir);
+    }
+    ~Cgroup() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+    Cgroup(const Cgroup&) = delete;
+    Cgroup& operator=(const Cgroup&) = delete;
+};
+
+// "key value" lines: adds the values of the wanted keys; keys must be listed in file order.
+inline void parse_flat_keyed(std::string_view text, std::initializer_list<std::pair<std::string_view, uint64_t*>> wanted) {
+    auto want = wanted.begin();
+    while (!text.empty() && want != wanted.end()) {
+        size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+        for (auto w = want; w != wanted.end(); ++w) {
+            if (line.size() > w->first.size() && line[w->first.size()] == ' ' && line.substr(0, w->first.size()) == w->first) {
+                std::from_chars(line.data() + w->first.size() + 1, line.data() + line.size(), *w->second);
+                want = w + 1;
+                break;
+            }
+        }
+    }
+}
+
+// io.stat: "8:0 rbytes=1 wbytes=2 rios=3 wios=4 ..." per device, summed.
+inline void parse_io_stat(std::string_view text, CgroupSample& out) {
+    const std::pair<std::string_view, uint64_t*> keys[] = {
+        {"rbytes=", &out.io_read_bytes}, {"wbytes=", &out.io_write_bytes},
+        {"rios=", &out.io_read_ops}, {"wios=", &out.io_write_ops},
+    };
+    size_t pos = 0;
+    while ((pos = text.find('=', pos)) != std::string_view::npos) {
+        size_t start = text.rfind(' ', pos);
+        start = start == std::string_view::npos ? 0 : start + 1;
+        std::string_view key = text.substr(start, pos - start + 1);
+        for (const auto& [name, field] : keys) {
+            if (key != name) continue;
+            uint64_t v = 0;
+            std::from_chars(text.data() + pos + 1, text.data() + text.size(), v);
+            *field += v;
+            break;
+        }
+        pos++;
+    }
+}
+
+// Reads every open file of one cgroup; false once the cgroup has been removed.
+inline bool sample_cgroup(Cgroup& cg, CgroupSample& out) {
+    char buf[4096];
+    auto read_fd = [&](int fd) -> std::string_view {
+        if (fd < 0) return {};
+        ssize_t n = pread(fd, buf, sizeof(buf), 0);
+        return n > 0 ? std::string_view(buf, static_cast<size_t>(n)) : std::string_view();
+    };
+    out = CgroupSample();
+    out.taken = std::chrono::steady_clock::now();
+    std::string_view cpu = read_fd(cg.fds[Cgroup::cpu_stat]);
+    if (cpu.empty()) return false;  // ENODEV after rmdir
+    parse_flat_keyed(cpu, {{"usage_usec", &out.cpu_usage_us}, {"user_usec", &out.cpu_user_us},
+                           {"system_usec", &out.cpu_system_us}, {"throttled_usec", &out.throttled_us}});
+    std::string_view current = read_fd(cg.fds[Cgroup::memory_current]);
+    std::from_chars(current.data(), current.data() + current.size(), out.memory_bytes);
+    parse_flat_keyed(read_fd(cg.fds[Cgroup::memory_stat]), {{"anon", &out.memory_anon}, {"file", &out.memory_file}});
+    parse_flat_keyed(read_fd(cg.fds[Cgroup::memory_events]), {{"oom_kill", &out.oom_kills}});
+    parse_io_stat(read_fd(cg.fds[Cgroup::io_stat]), out);
+    return true;
+}
+
+inline Reading cgroup_reading(const Cgroup& cg, const CgroupSample& prev, const CgroupSample& cur) {
+    Reading reading;
+    reading.sensor_id = cg.sensor_id;
+    double seconds = std::chrono::duration<double>(cur.taken - prev.taken).count();
+    auto delta = [](uint64_t a, uint64_t b) { return b >= a ? b - a : 0; };
+    auto rate = [&](uint64_t a, uint64_t b) { return seconds > 0 ? delta(a, b) / seconds : 0.0; };
+    reading.values = {
+        {"cpu_cores", rate(prev.cpu_usage_us, cur.cpu_usage_us) / 1e6},
+        {"cpu_user_cores", rate(prev.cpu_user_us, cur.cpu_user_us) / 1e6},
+        {"cpu_system_cores", rate(prev.cpu_system_us, cur.cpu_system_us) / 1e6},
+        {"throttled_ms_per_sec", rate(prev.throttled_us, cur.throttled_us) / 1e3},
+    };
+    if (cg.fds[Cgroup::memory_current] >= 0) {
+        reading.values.emplace_back("memory_bytes", static_cast<double>(cur.memory_bytes));
+        reading.values.emplace_back("memory_anon_bytes", static_cast<double>(cur.memory_anon));
+        reading.values.emplace_back("memory_file_bytes", static_cast<double>(cur.memory_file));
+        reading.values.emplace_back("oom_kills", static_cast<double>(delta(prev.oom_kills, cur.oom_kills)));
+    }
+    if (cg.fds[Cgroup::io_stat] >= 0) {
+        reading.values.emplace_back("io_read_bytes_per_sec", rate(prev.io_read_bytes, cur.io_read_bytes));
+        reading.values.emplace_back("io_write_bytes_per_sec", rate(prev.io_write_bytes, cur.io_write_bytes));
+        reading.values.emplace_back("io_read_ops_per_sec", rate(prev.io_read_ops, cur.io_read_ops));
+        reading.values.emplace_back("io_write_ops_per_sec", rate(prev.io_write_ops, cur.io_write_ops));
+    }
+    return reading;
+}
+
+class CgroupTracker {
+public:
+    CgroupTracker(std::string root, std::vector<std::string> include)
+        : root_(std::move(root)), include_(std::move(include)),
+          root_fd_(open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)),
+          inotify_fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+    ~CgroupTracker() {
+        if (inotify_fd_ >= 0) close(inotify_fd_);
+        if (root_fd_ >= 0) close(root_fd_);
+    }
+    CgroupTracker(const CgroupTracker&) = delete;
+    CgroupTracker& operator=(const CgroupTracker&) = delete;
+
+    bool ok() const { return root_fd_ >= 0 && inotify_fd_ >= 0; }
+    size_t tracked() const { return cgroups_.size(); }
+    size_t watched() const { return watches_.size(); }
+
+    // The one full walk: tracks the matching cgroups and watches every directory above them.
+    void start() { walk(""); }
+
+    // Applies queued inotify events: new directories are walked, removed ones dropped.
+    void apply_events() {
+        alignas(inotify_event) char buf[16384];
+        ssize_t n;
+        while ((n = read(inotify_fd_, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + n;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    std::cerr << "[WARN] cgroup inotify queue overflowed; rescanning the hierarchy" << std::endl;
+                    rescan();
+                    return;
+                }
+                auto it = watches_.find(event->wd);
+                if (event->mask & IN_IGNORED) {
+                    if (it != watches_.end()) watches_.erase(it);
+                    continue;
+                }
+                if (it == watches_.end() || !(event->mask & IN_ISDIR) || event->len == 0) continue;
+                std::string path = it->second.empty() ? event->name : it->second + "/" + event->name;
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) walk(path);
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) forget(path);
+                if (event->mask & IN_MOVED_FROM) unwatch(path);
+            }
+        }
+    }
+
+    // Samples every tracked cgroup on the pool and pushes one reading per container seen twice.
+    void sample(TaskPool& pool, ReadingQueue& out, size_t chunk = 16) {
+        size_t count = cgroups_.size();
+        pool.parallel_for((count + chunk - 1) / chunk, [&](size_t t) {
+            size_t end = std::min(count, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                Cgroup& cg = *cgroups_[i];
+                CgroupSample cur;
+                cg.reading.values.clear();
+                if (!sample_cgroup(cg, cur)) {
+                    cg.gone = true;
+                    continue;
+                }
+                if (cg.primed) cg.reading = cgroup_reading(cg, cg.prev, cur);
+                cg.prev = cur;
+                cg.primed = true;
+            }
+        });
+        std::string ts = timestamp();
+        for (auto& cg : cgroups_) {
+            if (cg->reading.values.empty()) continue;
+            cg->reading.timestamp = ts;
+            out.push(std::move(cg->reading));
+            cg->reading = Reading();
+        }
+        // Removed between the inotify event and the read: drop now rather than wait for the event
+        for (size_t i = 0; i < cgroups_.size();) {
+            if (cgroups_[i]->gone) forget(cgroups_[i]->path);
+            else ++i;
+        }
+    }
+
+private:
+    bool included(const std::string& path) const {
+        const char* name = path.c_str() + path.rfind('/') + 1;
+        for (const auto& pattern : include_) {
+            const char* subject = pattern.find('/') == std::string::npos ? name : path.c_str();
+            if (fnmatch(pattern.c_str(), subject, FNM_PATHNAME) == 0) return true;
+        }
+        return false;
+    }
+
+    // Watches path and everything below it up to the first matching cgroup on
+    // each branch (a container runtime may create nested slices before our watch lands).
+    void walk(const std::string& path) {
+        if (!path.empty() && included(path)) {
+            // Tracked but not watched: the parent's watch reports its removal, and
+            // whatever appears inside a container is the container's own business
+            if (index_.find(path) == index_.end()) {
+                index_[path] = cgroups_.size();
+                cgroups_.push_back(std::make_unique<Cgroup>(root_fd_, path));
+            }
+            return;
+        }
+        std::string full = path.empty() ? root_ : root_ + "/" + path;
+        int wd = inotify_add_watch(inotify_fd_, full.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_ONLYDIR);
+        if (wd < 0) {
+            if (errno == ENOSPC) std::cerr << "[WARN] Out of inotify watches at " << full << std::endl;
+            return;
+        }
+        watches_[wd] = path;
+        DIR* dir = opendir(full.c_str());
+        if (!dir) return;
+        std::vector<std::string> children;
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+                children.push_back(path.empty() ? entry->d_name : path + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+        for (const auto& child : children) walk(child);
+    }
+
+    static bool at_or_below(const std::string& p, const std::string& path) {
+        return p == path || (p.size() > path.size() && p.compare(0, path.size(), path) == 0 && p[path.size()] == '/');
+    }
+
+    // Drops path and any tracked cgroups below it; swap-with-last keeps the
+    // vector dense. path is a copy: callers pass a Cgroup's own path, which the swap frees.
+    void forget(std::string path) {
+        for (size_t i = 0; i < cgroups_.size();) {
+            if (!at_or_below(cgroups_[i]->path, path)) {
+                ++i;
+                continue;
+            }
+            index_.erase(cgroups_[i]->path);
+            if (i + 1 != cgroups_.size()) {
+                cgroups_[i] = std::move(cgroups_.back());
+                index_[cgroups_[i]->path] = i;
+            }
+            cgroups_.pop_back();
+        }
+    }
+
+    // A moved-away subtree keeps its watches, filed under the old paths; drop
+    // them (the move target, if under the root, is walked afresh). Deleted
+    // directories need none of this: the kernel sends IN_IGNORED for each.
+    void unwatch(const std::string& path) {
+        for (auto it = watches_.begin(); it != watches_.end();) {
+            if (!it->second.empty() && at_or_below(it->second, path)) {
+                inotify_rm_watch(inotify_fd_, it->first);
+                it = watches_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void rescan() {
+        for (const auto& [wd, path] : watches_) inotify_rm_watch(inotify_fd_, wd);
+        watches_.clear();
+        index_.clear();
+        cgroups_.clear();
+        walk("");
+    }
+
+    std::string root_;
+    std::vector<std::string> include_;
+    int root_fd_;
+    int inotify_fd_;
+    std::unordered_map<int, std::string> watches_;  // wd -> path relative to root
+    std::unordered_map<std::string, size_t> index_;  // path -> slot in cgroups_
+    std::vector<std::unique_ptr<Cgroup>> cgroups_;
+};
+
+inline void cgroup_thread(const std::atomic<bool>& running, ReadingQueue& out, TaskPool& pool, std::string root,
+                          std::vector<std::string> include, std::chrono::milliseconds interval) {
+    CgroupTracker tracker(root, std::move(include));
+    if (!tracker.ok()) {
+        std::cerr << "[ERROR] Cannot open cgroup root " << root << "; container metrics disabled" << std::endl;
+        return;
+    }
+    tracker.start();
+    std::cout << "[INFO] Container metrics thread started (" << tracker.tracked() << " containers, "
+              << tracker.watched() << " cgroups watched under " << root << ")." << std::endl;
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        tracker.apply_events();
+        tracker.sample(pool, out);
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+    std::cout << "[INFO] Container metrics thread exiting." << std::endl;
+}
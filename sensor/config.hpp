@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+
+// Agent settings come from the environment so docker-compose can tune them per deployment.
+inline std::string env_string(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    return value && *value ? std::string(value) : fallback;
+}
+
+inline long env_long(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    return end && *end == '\0' ? parsed : fallback;
+}
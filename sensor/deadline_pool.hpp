@@ -0,0 +1,160 @@
+#pragma once
+
+// Runs potentially blocking sources (statvfs on a hung NFS/FUSE mount, ...) on
+// a small pool of worker threads and waits for each sample only until its
+// deadline. A call that misses the deadline returns timed_out and leaves its
+// worker behind as "stuck"; the source is marked stale and further calls for it
+// are skipped without blocking until the stuck call finally returns. Blocked
+// syscalls cannot be cancelled, so stuck workers are detached rather than
+// joined and a fresh worker is started (up to max_workers) for the others.
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wire.hpp"
+
+enum class SampleStatus { ok, timed_out, skipped };
+
+template <typename T>
+struct Sample {
+    SampleStatus status = SampleStatus::skipped;
+    T value{};
+};
+
+class DeadlinePool {
+public:
+    explicit DeadlinePool(size_t max_workers) : state_(std::make_shared<State>()) {
+        state_->max_workers = max_workers > 0 ? max_workers : 1;
+    }
+
+    // Runs fn on a worker and waits at most deadline for its result.
+    template <typename T, typename Fn>
+    Sample<T> run(const std::string& source, Fn fn, std::chrono::milliseconds deadline) {
+        auto result = std::make_shared<T>();
+        auto job = std::make_shared<Job>();
+        job->source = source;
+        job->work = [result, fn] { *result = fn(); };
+
+        std::unique_lock<std::mutex> lock(state_->mu);
+        SourceState& src = state_->sources[source];
+        if (src.in_flight) {
+            src.skipped++;
+            return {SampleStatus::skipped, T{}};
+        }
+        src.in_flight = true;
+        state_->queue.push_back(job);
+        if (state_->idle == 0 && state_->workers < state_->max_workers) {
+            state_->workers++;
+            std::thread(worker, state_).detach();
+        }
+        state_->work_cv.notify_one();
+
+        if (!state_->done_cv.wait_for(lock, deadline, [&] { return job->done; })) {
+            src.timeouts++;
+            if (job->started) {
+                job->overdue = true;
+                state_->stuck++;
+            } else {
+                job->cancelled = true;  // never picked up: every worker is busy or stuck
+                src.in_flight = false;
+            }
+            if (!src.stale) {
+                std::cerr << "[WARN] Source " << source << " missed its " << deadline.count()
+                          << " ms deadline; marked stale (" << state_->stuck << " stuck workers)" << std::endl;
+            }
+            src.stale = true;
+            return {SampleStatus::timed_out, T{}};
+        }
+        src.stale = false;
+        return {SampleStatus::ok, std::move(*result)};
+    }
+
+    size_t stuck_workers() const {
+        std::lock_guard<std::mutex> lock(state_->mu);
+        return state_->stuck;
+    }
+
+    // "sampling_health": pool occupancy plus timeouts, skips and staleness per source.
+    Reading health_reading() const {
+        std::lock_guard<std::mutex> lock(state_->mu);
+        Reading reading;
+        reading.sensor_id = "sampling_health";
+        reading.timestamp = timestamp();
+        reading.values.emplace_back("workers", static_cast<double>(state_->workers));
+        reading.values.emplace_back("stuck_workers", static_cast<double>(state_->stuck));
+        for (const auto& [source, src] : state_->sources) {
+            reading.values.emplace_back(source + "_timeouts_total", static_cast<double>(src.timeouts));
+            reading.values.emplace_back(source + "_skipped_total", static_cast<double>(src.skipped));
+            reading.values.emplace_back(source + "_stale", src.stale ? 1.0 : 0.0);
+        }
+        return reading;
+    }
+
+private:
+    struct Job {
+        std::string source;
+        std::function<void()> work;
+        bool started = false;
+        bool done = false;
+        bool overdue = false;    // caller gave up while it was running
+        bool cancelled = false;  // caller gave up before a worker picked it up
+    };
+
+    struct SourceState {
+        bool in_flight = false;
+        bool stale = false;
+        uint64_t timeouts = 0;
+        uint64_t skipped = 0;
+    };
+
+    // Shared with the detached workers, which may outlive the pool
+    struct State {
+        std::mutex mu;
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        std::deque<std::shared_ptr<Job>> queue;
+        std::map<std::string, SourceState> sources;
+        size_t max_workers = 1;
+        size_t workers = 0;
+        size_t idle = 0;
+        size_t stuck = 0;
+    };
+
+    static void worker(std::shared_ptr<State> state) {
+        std::unique_lock<std::mutex> lock(state->mu);
+        while (true) {
+            state->idle++;
+            state->work_cv.wait(lock, [&] { return !state->queue.empty(); });
+            state->idle--;
+            std::shared_ptr<Job> job = std::move(state->queue.front());
+            state->queue.pop_front();
+            if (job->cancelled) continue;
+            job->started = true;
+
+            lock.unlock();
+            job->work();
+            lock.lock();
+
+            job->done = true;
+            SourceState& src = state->sources[job->source];
+            src.in_flight = false;
+            if (job->overdue) {
+                state->stuck--;
+                src.stale = false;
+                std::cout << "[INFO] Source " << job->source << " answered again; "
+                          << state->stuck << " stuck workers left" << std::endl;
+            }
+            state->done_cv.notify_all();
+        }
+    }
+
+    std::shared_ptr<State> state_;
+};
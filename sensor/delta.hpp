@@ -0,0 +1,134 @@
+#pragma once
+
+// Delta encoding for wide readings (per-CPU, per-process, per-container
+// tables) on the processor link: most of their values repeat from one tick to
+// the next, so after a keyframe only the values whose bits changed are sent.
+// Each reading object then carries
+//
+//   "delta": {"seq": 41, "keyframe": false}
+//
+// with seq counting per sensor id. The processor keeps the full value set per
+// (host, sensor id), merges each delta into it and ingests the result; when
+// it sees a gap in seq it ignores the stream until the next keyframe.
+//
+// A keyframe goes out on the first reading of a stream, every keyframe_every
+// readings after that, whenever the value names change (a process or mount
+// came or went), and for every stream after a failed delivery (resync()).
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "json_writer.hpp"
+#include "wire.hpp"
+
+class DeltaEncoder {
+public:
+    explicit DeltaEncoder(uint32_t keyframe_every) : keyframe_every_(keyframe_every > 0 ? keyframe_every : 1) {}
+
+    // Appends the reading as one JSON object: a keyframe or just its changed values.
+    void append(std::string& out, const Reading& reading, const AgentIdentity& id) {
+        refresh_identity(id);
+        if (streams_.size() >= kMaxStreams && streams_.find(reading.sensor_id) == streams_.end()) {
+            streams_.clear();  // unbounded sensor ids: start over, everything keyframes once
+        }
+        Stream& stream = streams_[reading.sensor_id];
+        bool keyframe = stream.force_keyframe || ++stream.since_keyframe >= keyframe_every_ ||
+                        !same_names(stream.last, reading.values);
+
+        out += "{\"sensor_id\":";
+        json_append_string(out, reading.sensor_id);
+        out += ",\"timestamp\":";
+        json_append_string(out, reading.timestamp);
+        out += reading.data_consistent ? ",\"data_consistent\":true" : ",\"data_consistent\":false";
+        if (!host_json_.empty()) {
+            out += ",\"host\":";
+            out += host_json_;
+        }
+        if (!labels_json_.empty()) {
+            out += ",\"labels\":";
+            out += labels_json_;
+        }
+        for (size_t i = 0; i < reading.values.size(); ++i) {
+            const auto& [key, value] = reading.values[i];
+            if (!keyframe && same_bits(stream.last[i].second, value)) continue;
+            out.push_back(',');
+            json_append_key(out, key);
+            json_append_double(out, value);
+        }
+        out += ",\"delta\":{\"seq\":";
+        out += std::to_string(++stream.seq);
+        out += keyframe ? ",\"keyframe\":true}}" : ",\"keyframe\":false}}";
+
+        if (keyframe) {
+            stream.last = reading.values;
+            stream.since_keyframe = 0;
+            stream.force_keyframe = false;
+            keyframes_++;
+        } else {
+            for (size_t i = 0; i < reading.values.size(); ++i) stream.last[i].second = reading.values[i].second;
+            deltas_++;
+        }
+    }
+
+    // The processor may have missed something: the next reading of every stream is a keyframe.
+    void resync() {
+        for (auto& entry : streams_) entry.second.force_keyframe = true;
+    }
+
+    uint64_t keyframes() const { return keyframes_; }
+    uint64_t deltas() const { return deltas_; }
+
+private:
+    static constexpr size_t kMaxStreams = 4096;
+
+    struct Stream {
+        std::vector<std::pair<std::string, double>> last;  // values as the processor now has them
+        uint64_t seq = 0;
+        uint32_t since_keyframe = 0;
+        bool force_keyframe = true;
+    };
+
+    // Bitwise, so a NaN that stays NaN is unchanged and -0.0 differs from 0.0.
+    static bool same_bits(double a, double b) { return std::memcmp(&a, &b, sizeof(double)) == 0; }
+
+    static bool same_names(const std::vector<std::pair<std::string, double>>& a,
+                           const std::vector<std::pair<std::string, double>>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].first != b[i].first) return false;
+        }
+        return true;
+    }
+
+    void refresh_identity(const AgentIdentity& id) {
+        if (identity_valid_ && id.host == identity_.host && id.labels == identity_.labels) return;
+        identity_ = id;
+        identity_valid_ = true;
+        host_json_.clear();
+        labels_json_.clear();
+        if (!id.host.empty()) json_append_string(host_json_, id.host);
+        if (!id.labels.empty()) {
+            std::map<std::string, std::string> sorted;
+            for (const auto& [key, value] : id.labels) sorted[key] = value;
+            labels_json_ = "{";
+            for (const auto& [key, value] : sorted) {
+                if (labels_json_.size() > 1) labels_json_.push_back(',');
+                json_append_key(labels_json_, key);
+                json_append_string(labels_json_, value);
+            }
+            labels_json_ += "}";
+        }
+    }
+
+    uint32_t keyframe_every_;
+    std::unordered_map<std::string, Stream> streams_;
+    AgentIdentity identity_;
+    bool identity_valid_ = false;
+    std::string host_json_;
+    std::string labels_json_;
+    uint64_t keyframes_ = 0;
+    uint64_t deltas_ = 0;
+};
@@ -0,0 +1,438 @@
+#pragma once
+
+// Derived metrics computed on the agent: ratios, sums and windowed averages of
+// values other sensors report, so the processor no longer has to.
+//
+//   DERIVED="proc_stat.cpu_busy_percent = proc_stat.cpu_user_percent + proc_stat.cpu_system_percent;
+//            disk_usage_root.usage_avg_5m = avg(disk_usage_root.disk_usage_percent, 5m);
+//            net_stack.retrans_ratio = net_stack.tcp_retrans_segs_per_sec / max(net_stack.tcp_out_segs_per_sec, 1)"
+//
+// Each definition is "<sensor_id>.<metric> = <expression>". An operand
+// "<sensor_id>.<metric>" is the latest value of that metric (sensor ids may
+// contain dots; the metric is after the last one). Expressions have + - * /,
+// unary minus, parentheses, abs(x), min(x, y), max(x, y), and the windowed
+// avg|min|max|sum|count(<sensor_id>.<metric>, <duration>) with durations like
+// 500ms, 30s, 5m or 1h.
+//
+// Definitions are parsed once into a flat postfix program over a slot table.
+// Incoming values are written into their slots (windows update incrementally),
+// so evaluating a definition is a short loop over a fixed stack with no
+// lookups. A definition is re-evaluated when one of its inputs arrived in the
+// batch and is emitted as a reading of its own sensor id; definitions may use
+// the outputs of earlier ones. Until every input has been seen, or when the
+// result is not finite (division by zero), nothing is emitted.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pipeline.hpp"
+#include "wire.hpp"
+
+struct DerivedOp {
+    enum Code : uint32_t { load, constant, add, sub, mul, div, neg, abs, min, max };
+    Code code;
+    uint32_t slot;  // load
+    double value;   // constant
+};
+
+// Postfix program; the parser guarantees the stack never exceeds kMaxDepth.
+struct DerivedProgram {
+    static constexpr size_t kMaxDepth = 32;
+
+    std::vector<DerivedOp> ops;
+    std::vector<uint32_t> inputs;  // slots read, without duplicates
+
+    double eval(const double* slots) const {
+        double stack[kMaxDepth];
+        size_t top = 0;
+        for (const DerivedOp& op : ops) {
+            switch (op.code) {
+                case DerivedOp::load: stack[top++] = slots[op.slot]; break;
+                case DerivedOp::constant: stack[top++] = op.value; break;
+                case DerivedOp::add: --top; stack[top - 1] += stack[top]; break;
+                case DerivedOp::sub: --top; stack[top - 1] -= stack[top]; break;
+                case DerivedOp::mul: --top; stack[top - 1] *= stack[top]; break;
+                case DerivedOp::div: --top; stack[top - 1] /= stack[top]; break;
+                case DerivedOp::neg: stack[top - 1] = -stack[top - 1]; break;
+                case DerivedOp::abs: stack[top - 1] = std::fabs(stack[top - 1]); break;
+                case DerivedOp::min: --top; stack[top - 1] = std::min(stack[top - 1], stack[top]); break;
+                case DerivedOp::max: --top; stack[top - 1] = std::max(stack[top - 1], stack[top]); break;
+            }
+        }
+        return stack[0];
+    }
+};
+
+class DerivedStage : public Stage {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Adds "<sensor_id>.<metric> = <expression>"; false (with error set) if it does not parse.
+    bool add(const std::string& definition, std::string& error) {
+        size_t eq = definition.find('=');
+        std::string target = trim_spec(definition.substr(0, eq == std::string::npos ? 0 : eq));
+        size_t dot = target.rfind('.');
+        if (eq == std::string::npos || dot == std::string::npos || dot == 0 || dot + 1 == target.size()) {
+            error = "expected <sensor_id>.<metric> = <expression>";
+            return false;
+        }
+        Definition def;
+        def.sensor_id = target.substr(0, dot);
+        def.metric = target.substr(dot + 1);
+        Parser parser{*this, definition, eq + 1, def.program, 0, 0};
+        if (!parser.parse(error)) return false;
+        for (const DerivedOp& op : def.program.ops) {
+            if (op.code == DerivedOp::load && std::find(def.program.inputs.begin(), def.program.inputs.end(), op.slot) == def.program.inputs.end()) {
+                def.program.inputs.push_back(op.slot);
+            }
+        }
+        size_t index = definitions_.size();
+        for (uint32_t slot : def.program.inputs) dependents_[slot].push_back(index);
+        latest_slot(def.sensor_id, def.metric);  // where later definitions read this one
+        definitions_.push_back(std::move(def));
+        dirty_.push_back(false);
+        return true;
+    }
+
+    bool empty() const { return definitions_.empty(); }
+    size_t size() const { return definitions_.size(); }
+
+    // Current value of definition index from the slots as they stand.
+    double evaluate(size_t index) const { return definitions_[index].program.eval(slots_.data()); }
+
+    void process(std::vector<Reading>& batch) override {
+        auto now = Clock::now();
+        bool any = false;
+        for (const Reading& reading : batch) {
+            auto it = bindings_.find(reading.sensor_id);
+            if (it == bindings_.end()) continue;
+            for (const auto& [key, value] : reading.values) {
+                for (const Binding& binding : it->second) {
+                    if (binding.metric == key) any |= store(binding, value, now);
+                }
+            }
+        }
+        if (!any) return;
+
+        std::string ts = timestamp();
+        size_t first_output = batch.size();
+        for (size_t i = 0; i < definitions_.size(); ++i) {
+            if (!dirty_[i]) continue;
+            dirty_[i] = false;
+            const Definition& def = definitions_[i];
+            double value = def.program.eval(slots_.data());
+            if (!std::isfinite(value)) continue;  // an input not seen yet (NaN) or a division by zero
+            auto out = std::find_if(batch.begin() + first_output, batch.end(),
+                                    [&](const Reading& r) { return r.sensor_id == def.sensor_id; });
+            if (out == batch.end()) {
+                batch.push_back(Reading{def.sensor_id, ts, {}, true});
+                out = batch.end() - 1;
+            }
+            out->values.emplace_back(def.metric, value);
+            // Later definitions may read this one
+            auto self = bindings_.find(def.sensor_id);
+            for (const Binding& binding : self->second) {
+                if (binding.metric == def.metric) store(binding, value, now);
+            }
+        }
+    }
+
+private:
+    static constexpr double kUnset = std::numeric_limits<double>::quiet_NaN();
+
+    enum class WindowKind { avg, min, max, sum, count };
+
+    // Samples of one metric over a trailing time window; its result lives in a slot.
+    struct Window {
+        WindowKind kind;
+        Clock::duration length;
+        std::deque<std::pair<Clock::time_point, double>> samples;
+        double sum = 0;
+    };
+
+    // Where a metric of a sensor goes: its latest-value slot or a window feeding a slot.
+    struct Binding {
+        std::string metric;
+        uint32_t slot;
+        int window;  // index into windows_, or -1
+    };
+
+    struct Definition {
+        std::string sensor_id;
+        std::string metric;
+        DerivedProgram program;
+    };
+
+    uint32_t new_slot() {
+        slots_.push_back(kUnset);
+        dependents_.emplace_back();
+        return static_cast<uint32_t>(slots_.size() - 1);
+    }
+
+    uint32_t latest_slot(const std::string& sensor_id, const std::string& metric) {
+        auto& bindings = bindings_[sensor_id];
+        for (const Binding& binding : bindings) {
+            if (binding.metric == metric && binding.window < 0) return binding.slot;
+        }
+        uint32_t slot = new_slot();
+        bindings.push_back({metric, slot, -1});
+        return slot;
+    }
+
+    uint32_t window_slot(const std::string& sensor_id, const std::string& metric, WindowKind kind, Clock::duration length) {
+        auto& bindings = bindings_[sensor_id];
+        for (const Binding& binding : bindings) {
+            if (binding.metric == metric && binding.window >= 0 && windows_[binding.window].kind == kind &&
+                windows_[binding.window].length == length) {
+                return binding.slot;
+            }
+        }
+        uint32_t slot = new_slot();
+        windows_.push_back({kind, length, {}, 0});
+        bindings.push_back({metric, slot, static_cast<int>(windows_.size() - 1)});
+        return slot;
+    }
+
+    // Writes a value into its slot (through the window if any) and marks the readers dirty.
+    bool store(const Binding& binding, double value, Clock::time_point now) {
+        if (binding.window < 0) {
+            slots_[binding.slot] = value;
+        } else {
+            Window& w = windows_[binding.window];
+            w.samples.emplace_back(now, value);
+            w.sum += value;
+            while (w.samples.front().first < now - w.length) {
+                w.sum -= w.samples.front().second;
+                w.samples.pop_front();
+            }
+            double result = 0;
+            switch (w.kind) {
+                case WindowKind::avg: result = w.sum / w.samples.size(); break;
+                case WindowKind::sum: result = w.sum; break;
+                case WindowKind::count: result = static_cast<double>(w.samples.size()); break;
+                case WindowKind::min:
+                case WindowKind::max:
+                    result = w.samples.front().second;
+                    for (const auto& sample : w.samples) {
+                        result = w.kind == WindowKind::min ? std::min(result, sample.second) : std::max(result, sample.second);
+                    }
+                    break;
+            }
+            slots_[binding.slot] = result;
+        }
+        for (size_t index : dependents_[binding.slot]) dirty_[index] = true;
+        return !dependents_[binding.slot].empty();
+    }
+
+    // Recursive descent straight to postfix:
+    //   expr := term (('+'|'-') term)*    term := unary (('*'|'/') unary)*
+    //   unary := '-' unary | primary      primary := number | ref | call | '(' expr ')'
+    struct Parser {
+        DerivedStage& stage;
+        const std::string& text;
+        size_t pos;
+        DerivedProgram& program;
+        size_t depth;
+        size_t max_depth;
+
+        bool parse(std::string& error) {
+            if (!expr(error)) return false;
+            skip_space();
+            if (pos != text.size()) {
+                error = "unexpected '" + text.substr(pos, 1) + "' at offset " + std::to_string(pos);
+                return false;
+            }
+            if (max_depth > DerivedProgram::kMaxDepth) {
+                error = "expression too deeply nested";
+                return false;
+            }
+            return true;
+        }
+
+        void skip_space() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n')) ++pos;
+        }
+
+        bool accept(char c) {
+            skip_space();
+            if (pos < text.size() && text[pos] == c) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        bool expect(char c, std::string& error) {
+            if (accept(c)) return true;
+            error = std::string("expected '") + c + "' at offset " + std::to_string(pos);
+            return false;
+        }
+
+        void emit(DerivedOp::Code code, uint32_t slot = 0, double value = 0) {
+            program.ops.push_back({code, slot, value});
+            if (code == DerivedOp::load || code == DerivedOp::constant) max_depth = std::max(max_depth, ++depth);
+            else if (code != DerivedOp::neg && code != DerivedOp::abs) --depth;
+        }
+
+        bool expr(std::string& error) {
+            if (!term(error)) return false;
+            while (true) {
+                if (accept('+')) {
+                    if (!term(error)) return false;
+                    emit(DerivedOp::add);
+                } else if (accept('-')) {
+                    if (!term(error)) return false;
+                    emit(DerivedOp::sub);
+                } else {
+                    return true;
+                }
+            }
+        }
+
+        bool term(std::string& error) {
+            if (!unary(error)) return false;
+            while (true) {
+                if (accept('*')) {
+                    if (!unary(error)) return false;
+                    emit(DerivedOp::mul);
+                } else if (accept('/')) {
+                    if (!unary(error)) return false;
+                    emit(DerivedOp::div);
+                } else {
+                    return true;
+                }
+            }
+        }
+
+        bool unary(std::string& error) {
+            if (accept('-')) {
+                if (!unary(error)) return false;
+                emit(DerivedOp::neg);
+                return true;
+            }
+            return primary(error);
+        }
+
+        static bool name_char(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+        }
+
+        bool primary(std::string& error) {
+            skip_space();
+            if (accept('(')) return expr(error) && expect(')', error);
+            if (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) || text[pos] == '.')) {
+                char* end = nullptr;
+                double value = std::strtod(text.c_str() + pos, &end);
+                pos = static_cast<size_t>(end - text.c_str());
+                emit(DerivedOp::constant, 0, value);
+                return true;
+            }
+            size_t start = pos;
+            while (pos < text.size() && name_char(text[pos])) ++pos;
+            std::string name = text.substr(start, pos - start);
+            if (name.empty()) {
+                error = pos < text.size() ? "unexpected '" + text.substr(pos, 1) + "' at offset " + std::to_string(pos)
+                                          : "expression ends early";
+                return false;
+            }
+            if (accept('(')) return call(name, error);
+            std::string sensor_id, metric;
+            if (!split_ref(name, sensor_id, metric, error)) return false;
+            emit(DerivedOp::load, stage.latest_slot(sensor_id, metric));
+            return true;
+        }
+
+        static bool split_ref(const std::string& name, std::string& sensor_id, std::string& metric, std::string& error) {
+            size_t dot = name.rfind('.');
+            if (dot == std::string::npos || dot == 0 || dot + 1 == name.size()) {
+                error = "'" + name + "' is not <sensor_id>.<metric>";
+                return false;
+            }
+            sensor_id = name.substr(0, dot);
+            metric = name.substr(dot + 1);
+            return true;
+        }
+
+        // "500ms", "30s", "5m", "1h"; false if the text at pos is not a duration.
+        bool duration(Clock::duration& out) {
+            skip_space();
+            char* end = nullptr;
+            double n = std::strtod(text.c_str() + pos, &end);
+            size_t after = static_cast<size_t>(end - text.c_str());
+            if (after == pos || n <= 0) return false;
+            std::string unit;
+            while (after < text.size() && std::isalpha(static_cast<unsigned char>(text[after]))) unit += text[after++];
+            double ms = unit == "ms" ? n : unit == "s" ? n * 1e3 : unit == "m" ? n * 6e4 : unit == "h" ? n * 3.6e6 : -1;
+            if (ms < 0) return false;
+            out = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+            pos = after;
+            return true;
+        }
+
+        bool call(const std::string& name, std::string& error) {
+            static const std::pair<const char*, WindowKind> windowed[] = {
+                {"avg", WindowKind::avg}, {"min", WindowKind::min}, {"max", WindowKind::max},
+                {"sum", WindowKind::sum}, {"count", WindowKind::count}};
+            // A windowed call is "<fn>(<ref>, <duration>)"; try that shape first
+            for (const auto& [fn, kind] : windowed) {
+                if (name != fn) continue;
+                size_t saved = pos;
+                skip_space();
+                size_t start = pos;
+                while (pos < text.size() && name_char(text[pos])) ++pos;
+                std::string ref = text.substr(start, pos - start);
+                Clock::duration length{};
+                std::string sensor_id, metric, ignored;
+                if (accept(',') && duration(length) && accept(')') && split_ref(ref, sensor_id, metric, ignored)) {
+                    emit(DerivedOp::load, stage.window_slot(sensor_id, metric, kind, length));
+                    return true;
+                }
+                pos = saved;
+            }
+            if (name == "abs") {
+                if (!expr(error) || !expect(')', error)) return false;
+                emit(DerivedOp::abs);
+                return true;
+            }
+            if (name == "min" || name == "max") {
+                if (!expr(error) || !expect(',', error) || !expr(error) || !expect(')', error)) return false;
+                emit(name == "min" ? DerivedOp::min : DerivedOp::max);
+                return true;
+            }
+            error = "unknown function '" + name + "'";
+            return false;
+        }
+    };
+
+    std::vector<Definition> definitions_;
+    std::vector<bool> dirty_;
+    std::vector<double> slots_;
+    std::vector<std::vector<size_t>> dependents_;  // slot -> definitions reading it
+    std::vector<Window> windows_;
+    std::unordered_map<std::string, std::vector<Binding>> bindings_;  // sensor id -> metrics of interest
+};
+
+// Stage for DERIVED (definitions separated by ';'); nullptr (with an error logged) if any is invalid.
+inline std::unique_ptr<DerivedStage> make_derived_stage(const std::string& spec) {
+    auto stage = std::make_unique<DerivedStage>();
+    stage->name = "derive";
+    for (const std::string& definition : split_spec(spec, ';')) {
+        if (trim_spec(definition).empty()) continue;
+        std::string error;
+        if (!stage->add(definition, error)) {
+            std::cerr << "[ERROR] Invalid derived metric '" << trim_spec(definition) << "': " << error << std::endl;
+            return nullptr;
+        }
+    }
+    return stage;
+}
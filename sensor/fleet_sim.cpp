@@ -0,0 +1,463 @@
+// Fleet simulator: drives the processor with thousands of virtual agents.
+//
+// Every agent has its own REQ connection, identity (host + rack label), sensor
+// set and share of the offered rate. A few threads each run an event loop over
+// their agents. The offered rate is ramped in steps until the processor starts
+// lagging (replies fall behind the offered rate or slow down) or dropping
+// (replies never arrive), and the last rate it sustained is reported.
+//
+// With --transport udp the agents send fire-and-forget datagrams instead; the
+// processor is asked after every step how many readings it received and how
+// many datagrams its sequence tracking saw go missing.
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <csignal>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <queue>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <zmq.hpp>
+#include "wire.hpp"
+#include "transport.hpp"
+#include "udp_transport.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> running(true);
+
+void handle_sigint(int) {
+    running = false;
+}
+
+struct SimOptions {
+    std::string endpoint = processor_endpoint();
+    std::string transport = "zmq";
+    std::string udp_endpoint = processor_udp_endpoint();
+    int agents = 1000;
+    int threads = 4;
+    int max_sensors = 4;
+    double start_rate = 500.0;    // fleet-wide messages/s offered in the first step
+    double ramp = 1.5;            // offered rate multiplier between steps
+    double max_rate = 500000.0;
+    int step_seconds = 10;
+    int reply_timeout_ms = 2000;  // no reply within this counts as dropped
+    int lag_p99_ms = 250;         // p99 reply latency above this counts as lagging
+};
+
+struct SimSensor {
+    std::string sensor_id;
+    std::string key;
+    double value;
+};
+
+struct SimAgent {
+    AgentIdentity identity;
+    zmq::socket_t sock;           // REQ socket (zmq transport)
+    UdpStream stream;             // datagram sequence (udp transport)
+    std::vector<SimSensor> sensors;
+    double rate_share = 0.0;      // fraction of the fleet rate this agent sends
+    size_t next_sensor = 0;
+    Clock::time_point next_due;
+    Clock::time_point sent_at;
+    bool in_flight = false;
+};
+
+// Reply latency in log2 microsecond buckets; cheap to record and to merge.
+struct LatencyHistogram {
+    std::array<uint64_t, 32> buckets{};
+    uint64_t count = 0;
+
+    void add(Clock::duration d) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        size_t b = 0;
+        while (us > 1 && b + 1 < buckets.size()) { us >>= 1; ++b; }
+        buckets[b]++;
+        count++;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < buckets.size(); ++i) buckets[i] += other.buckets[i];
+        count += other.count;
+    }
+
+    // Upper bound of the bucket holding the given quantile, in milliseconds.
+    double quantile_ms(double q) const {
+        if (count == 0) return 0.0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return std::ldexp(1.0, static_cast<int>(i) + 1) / 1000.0;
+        }
+        return std::ldexp(1.0, static_cast<int>(buckets.size())) / 1000.0;
+    }
+};
+
+struct StepStats {
+    uint64_t sent = 0;
+    uint64_t replies = 0;
+    uint64_t dropped = 0;   // request abandoned after reply_timeout_ms
+    uint64_t skipped = 0;   // agent was due but its previous request was still in flight
+    LatencyHistogram latency;
+
+    void merge(const StepStats& other) {
+        sent += other.sent;
+        replies += other.replies;
+        dropped += other.dropped;
+        skipped += other.skipped;
+        latency.merge(other.latency);
+    }
+};
+
+// Per-thread counters, handed over to the controller under a lock.
+struct ThreadSlot {
+    std::mutex mu;
+    StepStats stats;
+};
+
+static std::atomic<double> g_fleet_rate(0.0);
+
+static std::vector<SimAgent> make_agents(zmq::context_t& ctx, const SimOptions& opt, int first, int count, std::mt19937& rng) {
+    std::uniform_real_distribution<double> weight(0.5, 1.5);
+    std::uniform_int_distribution<int> sensor_count(1, std::max(1, opt.max_sensors));
+    std::uniform_real_distribution<double> start_value(5.0, 60.0);
+
+    std::vector<SimAgent> agents(count);
+    for (int i = 0; i < count; ++i) {
+        SimAgent& agent = agents[i];
+        char host[32];
+        std::snprintf(host, sizeof(host), "sim-%05d", first + i);
+        agent.identity.host = host;
+        agent.identity.labels.emplace_back("rack", "r" + std::to_string((first + i) % 16));
+        agent.identity.labels.emplace_back("simulated", "true");
+        if (opt.transport == "zmq") agent.sock = connect_processor(ctx, opt.endpoint, agent.identity.host, true);
+        agent.rate_share = weight(rng);
+
+        int sensors = sensor_count(rng);
+        for (int s = 0; s < sensors; ++s) {
+            if (s == 0) agent.sensors.push_back({"cpu_usage_01", "cpu_usage_percent", start_value(rng)});
+            else if (s == 1) agent.sensors.push_back({"disk_usage_root", "disk_usage_percent", start_value(rng)});
+            else agent.sensors.push_back({"sim_sensor_" + std::to_string(s), "value", start_value(rng)});
+        }
+    }
+    return agents;
+}
+
+static Reading next_reading(SimAgent& agent, std::mt19937& rng) {
+    std::normal_distribution<double> step(0.0, 1.5);
+    SimSensor& sensor = agent.sensors[agent.next_sensor++ % agent.sensors.size()];
+    sensor.value = std::clamp(sensor.value + step(rng), 0.0, 100.0);
+    Reading reading;
+    reading.sensor_id = sensor.sensor_id;
+    reading.timestamp = timestamp();
+    reading.values.emplace_back(sensor.key, sensor.value);
+    return reading;
+}
+
+void agent_loop(int thread_index, zmq::context_t& ctx, const SimOptions& opt, ThreadSlot& slot) {
+    int per_thread = opt.agents / opt.threads;
+    int first = thread_index * per_thread;
+    int count = thread_index == opt.threads - 1 ? opt.agents - first : per_thread;
+
+    std::mt19937 rng(1234 + thread_index);
+    std::vector<SimAgent> agents = make_agents(ctx, opt, first, count, rng);
+
+    // UDP agents of one thread share a socket; each keeps its own stream and sequence
+    const bool udp = opt.transport == "udp";
+    int udp_fd = -1;
+    std::vector<Reading> one(1);
+    std::vector<std::string> datagrams;
+    if (udp) {
+        udp_fd = open_udp_socket(opt.udp_endpoint);
+        if (udp_fd < 0) {
+            std::cerr << "[ERROR] Cannot open UDP socket to " << opt.udp_endpoint << std::endl;
+            return;
+        }
+    }
+
+    // Normalise weights so this thread's agents carry count/agents of the fleet rate
+    double local_total = 0.0;
+    for (const auto& agent : agents) local_total += agent.rate_share;
+    for (auto& agent : agents) agent.rate_share *= (static_cast<double>(count) / opt.agents) / local_total;
+
+    std::vector<zmq::pollitem_t> items(udp ? 0 : agents.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        items[i] = {agents[i].sock.handle(), 0, ZMQ_POLLIN, 0};
+    }
+
+    using Due = std::pair<Clock::time_point, size_t>;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> schedule;
+    std::uniform_real_distribution<double> phase(0.0, 1.0);
+    auto now = Clock::now();
+    for (size_t i = 0; i < agents.size(); ++i) {
+        agents[i].next_due = now + std::chrono::milliseconds(static_cast<int>(phase(rng) * 1000));
+        schedule.push({agents[i].next_due, i});
+    }
+
+    StepStats local;
+    auto last_flush = now;
+    auto last_timeout_scan = now;
+    const auto reply_timeout = std::chrono::milliseconds(opt.reply_timeout_ms);
+
+    while (running) {
+        now = Clock::now();
+        double fleet_rate = g_fleet_rate.load(std::memory_order_relaxed);
+
+        // Send for every agent whose next reading is due
+        while (!schedule.empty() && schedule.top().first <= now) {
+            size_t i = schedule.top().second;
+            schedule.pop();
+            SimAgent& agent = agents[i];
+
+            if (udp) {
+                one[0] = next_reading(agent, rng);
+                pack_datagrams(agent.stream, one, agent.identity, kUdpDefaultDatagram, datagrams);
+            } else if (agent.in_flight) {
+                local.skipped++;
+            } else {
+                std::string payload = encode_reading(next_reading(agent, rng), agent.identity);
+                try {
+                    if (agent.sock.send(zmq::buffer(payload), zmq::send_flags::dontwait)) {
+                        agent.in_flight = true;
+                        agent.sent_at = now;
+                        local.sent++;
+                    } else {
+                        local.skipped++;
+                    }
+                } catch (const zmq::error_t&) {
+                    local.skipped++;
+                }
+            }
+
+            double agent_rate = fleet_rate * agent.rate_share;
+            auto interval = agent_rate > 0.0
+                ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / agent_rate))
+                : std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1));
+            agent.next_due += interval;
+            if (agent.next_due < now) agent.next_due = now + interval;
+            schedule.push({agent.next_due, i});
+        }
+
+        // All datagrams of this pass leave in sendmmsg batches
+        if (udp && !datagrams.empty()) {
+            size_t sent = send_datagrams(udp_fd, datagrams);
+            local.sent += sent;
+            local.skipped += datagrams.size() - sent;
+            datagrams.clear();
+        }
+
+        long wait_ms = 10;
+        if (!schedule.empty()) {
+            auto until = std::chrono::duration_cast<std::chrono::milliseconds>(schedule.top().first - Clock::now()).count();
+            wait_ms = std::clamp<long>(until, 0, 10);
+        }
+        if (udp) std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+        else zmq::poll(items.data(), items.size(), wait_ms);
+
+        now = Clock::now();
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (!(items[i].revents & ZMQ_POLLIN)) continue;
+            // REQ delivers at most one reply per request; a stale one is discarded by REQ_CORRELATE
+            zmq::message_t reply;
+            if (agents[i].in_flight && agents[i].sock.recv(reply, zmq::recv_flags::dontwait)) {
+                local.latency.add(now - agents[i].sent_at);
+                local.replies++;
+                agents[i].in_flight = false;
+            }
+        }
+
+        // Requests without a reply for too long are dropped; REQ_RELAXED lets the agent go on
+        if (now - last_timeout_scan > std::chrono::milliseconds(50)) {
+            for (auto& agent : agents) {
+                if (agent.in_flight && now - agent.sent_at > reply_timeout) {
+                    agent.in_flight = false;
+                    local.dropped++;
+                }
+            }
+            last_timeout_scan = now;
+        }
+
+        if (now - last_flush > std::chrono::milliseconds(100)) {
+            std::lock_guard<std::mutex> lock(slot.mu);
+            slot.stats.merge(local);
+            local = StepStats();
+            last_flush = now;
+        }
+    }
+    if (udp_fd >= 0) close(udp_fd);
+}
+
+struct UdpTotals {
+    double records = 0.0;
+    double lost = 0.0;
+};
+
+// Asks the processor how many UDP readings arrived and how many datagrams went missing.
+static bool query_udp_totals(zmq::context_t& ctx, const std::string& endpoint, UdpTotals& totals) {
+    try {
+        zmq::socket_t sock = connect_processor(ctx, endpoint);
+        sock.set(zmq::sockopt::rcvtimeo, 5000);
+        sock.send(zmq::buffer(std::string(R"({"control":"transport_stats"})")), zmq::send_flags::none);
+        zmq::message_t reply;
+        if (!sock.recv(reply, zmq::recv_flags::none)) return false;
+        auto udp = nlohmann::json::parse(reply.to_string()).at("udp");
+        totals.records = udp.at("records").get<double>();
+        totals.lost = udp.at("lost").get<double>();
+        return true;
+    } catch (const std::exception& ex) {
+        std::cerr << "[WARN] Could not query processor transport stats: " << ex.what() << std::endl;
+        return false;
+    }
+}
+
+static void usage() {
+    std::cout << "Usage: fleet_sim [--endpoint EP] [--agents N] [--threads T] [--sensors S]\n"
+                 "                 [--start-rate MSG_PER_S] [--ramp FACTOR] [--max-rate MSG_PER_S]\n"
+                 "                 [--step-seconds S] [--reply-timeout-ms MS] [--lag-p99-ms MS]\n"
+                 "                 [--transport zmq|udp] [--udp-endpoint HOST:PORT]\n";
+}
+
+static bool parse_options(int argc, char** argv, SimOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (arg == "--endpoint") opt.endpoint = value;
+        else if (arg == "--agents") opt.agents = std::stoi(value);
+        else if (arg == "--threads") opt.threads = std::stoi(value);
+        else if (arg == "--sensors") opt.max_sensors = std::stoi(value);
+        else if (arg == "--start-rate") opt.start_rate = std::stod(value);
+        else if (arg == "--ramp") opt.ramp = std::stod(value);
+        else if (arg == "--max-rate") opt.max_rate = std::stod(value);
+        else if (arg == "--step-seconds") opt.step_seconds = std::stoi(value);
+        else if (arg == "--reply-timeout-ms") opt.reply_timeout_ms = std::stoi(value);
+        else if (arg == "--lag-p99-ms") opt.lag_p99_ms = std::stoi(value);
+        else if (arg == "--transport") opt.transport = value;
+        else if (arg == "--udp-endpoint") opt.udp_endpoint = value;
+        else return false;
+    }
+    opt.threads = std::max(1, std::min(opt.threads, opt.agents));
+    return opt.agents > 0 && opt.ramp > 1.0 && opt.step_seconds > 0 &&
+           (opt.transport == "zmq" || opt.transport == "udp");
+}
+
+// Each agent holds one TCP connection; make sure the fd limit allows it.
+static void raise_fd_limit(int agents) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) != 0) return;
+    rlim_t wanted = static_cast<rlim_t>(agents) * 2 + 256;
+    if (lim.rlim_cur >= wanted) return;
+    lim.rlim_cur = std::min(wanted, lim.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &lim);
+    if (lim.rlim_cur < wanted) {
+        std::cerr << "[WARN] File descriptor limit " << lim.rlim_cur << " may be too low for "
+                  << agents << " agents" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    SimOptions opt;
+    if (!parse_options(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+    std::signal(SIGINT, handle_sigint);
+    std::signal(SIGTERM, handle_sigint);
+    raise_fd_limit(opt.agents);
+
+    const bool udp = opt.transport == "udp";
+    std::cout << "[INFO] Simulating " << opt.agents << " agents on " << opt.threads << " threads against "
+              << (udp ? opt.udp_endpoint + " (udp)" : opt.endpoint + " (zmq)") << std::endl;
+
+    zmq::context_t ctx(std::max(1, opt.threads / 2), opt.agents + 64);
+
+    std::vector<ThreadSlot> slots(opt.threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < opt.threads; ++t) {
+        threads.emplace_back(agent_loop, t, std::ref(ctx), std::cref(opt), std::ref(slots[t]));
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "[STEP] offered/s  sent/s  " << (udp ? "received/s" : " replies/s")
+              << "  p50_ms  p99_ms  dropped  skipped  verdict" << std::endl;
+
+    double rate = opt.start_rate;
+    double sustained = 0.0;
+    double broke_at = 0.0;
+    bool retried = false;
+    while (running && rate <= opt.max_rate) {
+        g_fleet_rate = rate;
+
+        // Let agent intervals settle on the new rate before counting
+        auto warmup_end = Clock::now() + std::chrono::milliseconds(std::min(1000, opt.step_seconds * 250));
+        while (running && Clock::now() < warmup_end) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        for (auto& slot : slots) {
+            std::lock_guard<std::mutex> lock(slot.mu);
+            slot.stats = StepStats();
+        }
+        UdpTotals before, after;
+        if (udp) query_udp_totals(ctx, opt.endpoint, before);
+        auto step_start = Clock::now();
+        while (running && Clock::now() - step_start < std::chrono::seconds(opt.step_seconds)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - step_start).count();
+
+        StepStats total;
+        for (auto& slot : slots) {
+            std::lock_guard<std::mutex> lock(slot.mu);
+            total.merge(slot.stats);
+        }
+        double achieved = total.replies / elapsed;
+        double p99 = total.latency.quantile_ms(0.99);
+        bool lagging = achieved < 0.95 * rate || p99 > opt.lag_p99_ms;
+        bool dropping = total.dropped > 0;
+        if (udp) {
+            // No replies: delivery is what the processor counted, loss what its sequence tracking saw
+            if (query_udp_totals(ctx, opt.endpoint, after)) {
+                achieved = (after.records - before.records) / elapsed;
+                total.dropped = static_cast<uint64_t>(std::max(0.0, after.lost - before.lost));
+            }
+            lagging = achieved < 0.95 * rate;
+            dropping = total.dropped > 0;
+        }
+        const char* verdict = dropping ? "DROPPING" : lagging ? "LAGGING" : "OK";
+
+        std::cout << "[STEP] " << std::setw(9) << rate << " " << std::setw(7) << total.sent / elapsed
+                  << " " << std::setw(10) << achieved << " " << std::setw(7) << total.latency.quantile_ms(0.5)
+                  << " " << std::setw(7) << p99 << " " << std::setw(8) << total.dropped
+                  << " " << std::setw(8) << total.skipped << "  " << verdict << std::endl;
+
+        if (!lagging && !dropping) {
+            sustained = achieved;
+            retried = false;
+            rate *= opt.ramp;
+        } else if (!retried) {
+            // One bad step can be a hiccup; confirm at the same rate before stopping
+            retried = true;
+        } else {
+            broke_at = rate;
+            break;
+        }
+    }
+
+    running = false;
+    for (auto& t : threads) t.join();
+
+    std::cout << "[RESULT] Sustained ingest rate: " << sustained << " msg/s";
+    if (broke_at > 0.0) std::cout << "; processor started lagging/dropping at " << broke_at << " msg/s offered";
+    else std::cout << "; no saturation found up to " << std::min(rate, opt.max_rate) << " msg/s offered";
+    std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+// Where interrupts land: /proc/interrupts and /proc/softirqs parsed into a
+// source x CPU matrix of counts, differenced against the previous tick and
+// published as one "interrupts" and one "softirqs" reading. The aggregate
+// cpu_usage hides a NIC whose queues all fire on CPU0; this does not.
+//
+// Both files share one layout: a header naming the online CPUs, then one
+// "label: n n n ... [description]" row per source. Counts live in one flat
+// row-major array (row * cpus + column) so the per-tick delta is a single
+// loop over contiguous 32-bit cells that the compiler vectorises. The kernel
+// keeps these per-CPU counts as unsigned int, so the delta is taken modulo 2^32
+// and survives wraparound.
+//
+// Cells are published per second as "<source>_cpu<N>", in one of two forms:
+//   sparse  only the cells that counted this tick (the default)
+//   dense   every cell of each source that has fired since the last layout
+//           change, zeros included, so the key set only changes when a quiet
+//           line first fires
+// Dense only pays off when every sink is a delta link (delta.hpp), which sends
+// the unchanged cells for next to nothing; on 128 CPUs one busy NIC queue row
+// alone is 128 values, so the udp/file/influx/otlp sinks get the sparse form.
+// The hundreds of lines that never fire are left out either way. Alongside go a
+// dense per-CPU total ("cpu<N>") and "top_cpu_share", the busiest CPU's
+// fraction of the total, which is what an alert on IRQ imbalance wants.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+struct IrqMatrix {
+    std::chrono::steady_clock::time_point taken;
+    std::vector<uint32_t> cpu_ids;     // column -> CPU number (offline CPUs have no column)
+    std::vector<std::string> sources;  // row -> lowercased label ("24", "loc", "net_rx")
+    std::vector<uint32_t> counts;      // sources.size() x cpu_ids.size(), row-major
+    uint64_t layout = 0;               // bumped whenever rows or columns change
+
+    size_t cpus() const { return cpu_ids.size(); }
+};
+
+class IrqTableReader {
+public:
+    explicit IrqTableReader(const char* path) : fd_(open(path, O_RDONLY | O_CLOEXEC)), buf_(65536) {}
+    ~IrqTableReader() { if (fd_ >= 0) close(fd_); }
+    IrqTableReader(const IrqTableReader&) = delete;
+    IrqTableReader& operator=(const IrqTableReader&) = delete;
+
+    bool read(IrqMatrix& out) {
+        if (fd_ < 0) return false;
+        ssize_t n;
+        // One byte is kept for the terminator the parser relies on instead of bounds checks
+        while ((n = pread(fd_, buf_.data(), buf_.size() - 1, 0)) == static_cast<ssize_t>(buf_.size() - 1)) {
+            buf_.resize(buf_.size() * 2);
+        }
+        if (n <= 0) return false;
+        buf_[n] = '\0';
+        out.taken = std::chrono::steady_clock::now();
+        return parse(buf_.data(), static_cast<size_t>(n), out);
+    }
+
+    // Parses NUL-terminated text into out, keeping out's layout when the header and labels still match.
+    bool parse(const char* text, size_t size, IrqMatrix& out) {
+        const char* p = text;
+        const char* end = text + size;
+        const char* eol = line_end(p, end);
+        if (std::string_view(p, eol - p) != header_ || out.cpu_ids.empty()) {
+            header_.assign(p, eol - p);
+            out.cpu_ids.clear();
+            for (const char* h = p; (h = find_cpu(h, eol)) != nullptr;) {
+                uint32_t id = 0;
+                for (h += 3; *h >= '0' && *h <= '9'; ++h) id = id * 10 + (*h - '0');
+                out.cpu_ids.push_back(id);
+            }
+            out.sources.clear();
+            out.layout++;
+        }
+        const size_t cpus = out.cpu_ids.size();
+        if (cpus == 0) return false;
+
+        size_t row = 0;
+        for (p = eol + (eol < end); p < end; p = eol + (eol < end)) {
+            eol = line_end(p, end);
+            while (*p == ' ') ++p;
+            const char* colon = p;
+            while (colon < eol && *colon != ':') ++colon;
+            if (colon == eol) continue;
+            std::string_view label(p, colon - p);
+            // ERR and MIS are machine-wide totals printed in the first column, not per-CPU counts
+            if (label == "ERR" || label == "MIS") continue;
+
+            if (row >= out.sources.size() || !same_label(out.sources[row], label)) {
+                if (row < out.sources.size()) out.sources.resize(row);
+                out.sources.push_back(lowercase(label));
+                out.layout++;
+            }
+            if (out.counts.size() < (row + 1) * cpus) out.counts.resize((row + 1) * cpus);
+            uint32_t* cells = &out.counts[row * cpus];
+            const char* q = colon + 1;
+            size_t column = 0;
+            for (; column < cpus; ++column) {
+                while (*q == ' ') ++q;
+                if (*q < '0' || *q > '9') break;
+                uint32_t v = 0;
+                for (; *q >= '0' && *q <= '9'; ++q) v = v * 10 + static_cast<uint32_t>(*q - '0');
+                cells[column] = v;
+            }
+            for (; column < cpus; ++column) cells[column] = 0;
+            row++;
+        }
+        if (row != out.sources.size()) {
+            out.sources.resize(row);
+            out.layout++;
+        }
+        out.counts.resize(row * cpus);
+        return row > 0;
+    }
+
+private:
+    static const char* line_end(const char* p, const char* end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return nl ? nl : end;
+    }
+
+    static const char* find_cpu(const char* p, const char* end) {
+        for (; p + 3 <= end; ++p) {
+            if (p[0] == 'C' && p[1] == 'P' && p[2] == 'U') return p;
+        }
+        return nullptr;
+    }
+
+    static bool same_label(const std::string& lowered, std::string_view label) {
+        if (lowered.size() != label.size()) return false;
+        for (size_t i = 0; i < label.size(); ++i) {
+            char c = label[i];
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            if (lowered[i] != c) return false;
+        }
+        return true;
+    }
+
+    static std::string lowercase(std::string_view label) {
+        std::string out(label);
+        for (char& c : out) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        }
+        return out;
+    }
+
+    int fd_;
+    std::vector<char> buf_;
+    std::string header_;
+};
+
+// cur - prev per cell, modulo 2^32. Both matrices must share a layout.
+inline void irq_deltas(const IrqMatrix& prev, const IrqMatrix& cur, std::vector<uint32_t>& out) {
+    const size_t cells = cur.counts.size();
+    out.resize(cells);
+    const uint32_t* a = prev.counts.data();
+    const uint32_t* b = cur.counts.data();
+    uint32_t* d = out.data();
+    for (size_t i = 0; i < cells; ++i) d[i] = b[i] - a[i];
+}
+
+// Rows that have fired since the last layout change, with their cell names built once.
+struct IrqActiveRows {
+    std::vector<uint8_t> rows;       // row -> has fired
+    std::vector<std::string> names;  // row * cpus + column -> "<source>_cpu<N>", filled as rows activate
+
+    void clear() {
+        rows.clear();
+        names.clear();
+    }
+};
+
+// Reading over the delta matrix: the non-zero cells, or with dense every cell of
+// the active rows (a row with any count this tick becomes active), then per-CPU
+// totals and the busiest CPU's share.
+inline Reading irq_reading(const char* sensor_id, const IrqMatrix& cur, const std::vector<uint32_t>& deltas,
+                           double seconds, IrqActiveRows& active, bool dense) {
+    Reading reading;
+    reading.sensor_id = sensor_id;
+    reading.timestamp = timestamp();
+    const size_t cpus = cur.cpus();
+    const double per_sec = seconds > 0 ? 1.0 / seconds : 0.0;
+
+    std::vector<uint64_t> per_cpu(cpus, 0);
+    active.rows.resize(cur.sources.size(), 0);
+    active.names.resize(cur.sources.size() * cpus);
+    for (size_t row = 0; row < cur.sources.size(); ++row) {
+        const uint32_t* cells = &deltas[row * cpus];
+        std::string* names = &active.names[row * cpus];
+        if (!active.rows[row]) {
+            uint32_t any = 0;
+            for (size_t c = 0; c < cpus; ++c) any |= cells[c];
+            if (any == 0) continue;  // most rows never fire
+            active.rows[row] = 1;
+            for (size_t c = 0; c < cpus; ++c) names[c] = cur.sources[row] + "_cpu" + std::to_string(cur.cpu_ids[c]);
+        }
+        for (size_t c = 0; c < cpus; ++c) {
+            per_cpu[c] += cells[c];
+            if (dense || cells[c] != 0) reading.values.emplace_back(names[c], cells[c] * per_sec);
+        }
+    }
+
+    uint64_t total = 0, top = 0;
+    for (size_t c = 0; c < cpus; ++c) {
+        reading.values.emplace_back("cpu" + std::to_string(cur.cpu_ids[c]), per_cpu[c] * per_sec);
+        total += per_cpu[c];
+        top = std::max(top, per_cpu[c]);
+    }
+    reading.values.emplace_back("total_per_sec", total * per_sec);
+    reading.values.emplace_back("top_cpu_share", total > 0 ? static_cast<double>(top) / total : 0.0);
+    return reading;
+}
+
+// Keeps one file's previous matrix and turns each new read into a reading; a
+// changed layout (new IRQ line, CPU hotplug) skips one tick instead of publishing garbage.
+class IrqDistribution {
+public:
+    IrqDistribution(const char* sensor_id, const char* path, bool dense)
+        : sensor_id_(sensor_id), reader_(path), dense_(dense) {}
+
+    bool sample(ReadingQueue& out) {
+        if (!reader_.read(cur_)) return false;
+        if (primed_ && cur_.layout == prev_layout_) {
+            irq_deltas(prev_, cur_, deltas_);
+            double seconds = std::chrono::duration<double>(cur_.taken - prev_.taken).count();
+            out.push(irq_reading(sensor_id_, cur_, deltas_, seconds, active_, dense_));
+        } else {
+            active_.clear();
+        }
+        primed_ = true;
+        prev_layout_ = cur_.layout;
+        prev_.taken = cur_.taken;
+        prev_.counts.swap(cur_.counts);
+        // cur_ keeps the layout (ids, labels) for the next parse; its counts are rewritten in full
+        cur_.counts.resize(prev_.counts.size());
+        return true;
+    }
+
+private:
+    const char* sensor_id_;
+    IrqTableReader reader_;
+    IrqMatrix prev_, cur_;
+    std::vector<uint32_t> deltas_;
+    IrqActiveRows active_;
+    bool dense_;
+    uint64_t prev_layout_ = 0;
+    bool primed_ = false;
+};
+
+// dense: publish the dense form, for when every sink is a delta link.
+inline void irq_distribution_thread(const std::atomic<bool>& running, ReadingQueue& out,
+                                    std::chrono::milliseconds interval, bool dense) {
+    std::cout << "[INFO] IRQ distribution thread started (" << (dense ? "dense" : "sparse") << ")." << std::endl;
+    IrqDistribution interrupts("interrupts", "/proc/interrupts", dense);
+    IrqDistribution softirqs("softirqs", "/proc/softirqs", dense);
+    bool have_interrupts = interrupts.sample(out);
+    bool have_softirqs = softirqs.sample(out);
+    if (!have_interrupts && !have_softirqs) {
+        std::cerr << "[ERROR] Cannot read /proc/interrupts or /proc/softirqs; IRQ distribution disabled" << std::endl;
+        return;
+    }
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        next += interval;
+        std::this_thread::sleep_until(next);
+        if (have_interrupts) interrupts.sample(out);
+        if (have_softirqs) softirqs.sample(out);
+    }
+    std::cout << "[INFO] IRQ distribution thread exiting." << std::endl;
+}
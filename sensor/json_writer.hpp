@@ -0,0 +1,109 @@
+#pragma once
+
+// Streaming JSON output appended straight into a caller-owned buffer. The
+// formatting follows nlohmann::json::dump() so both encoders produce the same
+// bytes: strings escaped the same way (UTF-8 passed through), doubles as the
+// shortest round-trip digits laid out like nlohmann's grisu2 output ("12.0",
+// "0.0001", "1e-05", "1e+16"), NaN and infinities as null.
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+inline void json_append_string(std::string& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t run = 0;  // start of the pending stretch that needs no escaping
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(s.data() + run, i - run);
+        run = i + 1;
+        out.push_back('\\');
+        switch (c) {
+            case '"':  out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '\b': out.push_back('b'); break;
+            case '\f': out.push_back('f'); break;
+            case '\n': out.push_back('n'); break;
+            case '\r': out.push_back('r'); break;
+            case '\t': out.push_back('t'); break;
+            default:
+                out += "u00";
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xf]);
+        }
+    }
+    out.append(s.data() + run, s.size() - run);
+    out.push_back('"');
+}
+
+// `"key":`, the fragment in front of every object member.
+inline void json_append_key(std::string& out, std::string_view key) {
+    json_append_string(out, key);
+    out.push_back(':');
+}
+
+inline void json_append_double(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    if (value == 0) {
+        out += std::signbit(value) ? "-0.0" : "0.0";
+        return;
+    }
+    if (std::fabs(value) < 1e15 && std::trunc(value) == value) {
+        // Counters: integral and exact, printed as the integer plus ".0" at a fraction of the cost
+        char buf[24];
+        out.append(buf, std::to_chars(buf, buf + sizeof(buf), static_cast<int64_t>(value)).ptr - buf);
+        out += ".0";
+        return;
+    }
+
+    // Shortest digits and exponent from to_chars, then nlohmann's layout rules
+    char sci[32];
+    char* end = std::to_chars(sci, sci + sizeof(sci) - 1, value, std::chars_format::scientific).ptr;
+    *end = '\0';
+    char* p = sci;
+    if (*p == '-') out.push_back(*p++);
+    char* e = std::find(p, end, 'e');
+    char digits[20];
+    int k = 0;
+    for (char* q = p; q < e; ++q) {
+        if (*q != '.') digits[k++] = *q;
+    }
+    int n = std::atoi(e + 1) + 1;  // digits[0..n) are the integer part
+
+    constexpr int kMinExp = -4;
+    constexpr int kMaxExp = 15;  // std::numeric_limits<double>::digits10
+    if (k <= n && n <= kMaxExp) {
+        out.append(digits, k);
+        out.append(n - k, '0');
+        out += ".0";
+    } else if (0 < n && n <= kMaxExp) {
+        out.append(digits, n);
+        out.push_back('.');
+        out.append(digits + n, k - n);
+    } else if (kMinExp < n && n <= 0) {
+        out += "0.";
+        out.append(-n, '0');
+        out.append(digits, k);
+    } else {
+        out.push_back(digits[0]);
+        if (k > 1) {
+            out.push_back('.');
+            out.append(digits + 1, k - 1);
+        }
+        int exp = n - 1;
+        out.push_back('e');
+        out.push_back(exp < 0 ? '-' : '+');
+        exp = std::abs(exp);
+        if (exp < 10) out.push_back('0');
+        char buf[4];
+        out.append(buf, std::to_chars(buf, buf + sizeof(buf), exp).ptr - buf);
+    }
+}
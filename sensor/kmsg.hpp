@@ -0,0 +1,282 @@
+#pragma once
+
+// Kernel log events: OOM kills, disk errors, hung tasks and friends, read from
+// /dev/kmsg as they are logged. The monitor thread sits in a blocking poll on
+// the kmsg fd (plus an eventfd for shutdown), so it costs nothing while the
+// kernel is quiet. Each record is matched against precompiled literal searchers
+// per class; a match becomes a "kmsg_<class>" reading on the sinks' priority
+// path and the record text goes to the agent log, since readings only carry
+// numbers. Per-class totals travel with the periodic stats readings.
+//
+// The last sequence number handled is persisted (with the boot id, as sequence
+// numbers restart at boot) so a restarted agent skips what it already reported
+// instead of replaying the whole ring buffer. With no state it starts at the
+// end of the buffer; after a reboot it reads this boot's records from the start,
+// so disk errors, MCEs and OOMs logged while the machine came up are reported.
+// Device probing noise (empty SATA ports, floppy and CD-ROM drives probed for
+// media) is kept out by the class literals and per-class exclusions instead,
+// and counted as suppressed.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "wire.hpp"
+
+struct KmsgRecord {
+    int priority = 6;  // syslog level 0 (emerg) .. 7 (debug)
+    uint64_t sequence = 0;
+    uint64_t usec = 0;  // since boot
+    std::string_view message;
+};
+
+// "pri_fac,seq,usec,flags[,...];message\n KEY=value..." -> record; false if malformed.
+inline bool parse_kmsg_record(std::string_view text, KmsgRecord& out) {
+    size_t semi = text.find(';');
+    if (semi == std::string_view::npos) return false;
+    const char* p = text.data();
+    const char* end = p + semi;
+    uint64_t fields[3] = {};
+    for (uint64_t& field : fields) {
+        auto res = std::from_chars(p, end, field);
+        if (res.ec != std::errc()) return false;
+        p = res.ptr < end && *res.ptr == ',' ? res.ptr + 1 : res.ptr;
+    }
+    out.priority = static_cast<int>(fields[0] & 7);
+    out.sequence = fields[1];
+    out.usec = fields[2];
+    std::string_view message = text.substr(semi + 1);
+    out.message = message.substr(0, message.find('\n'));  // continuation lines hold dictionary entries
+    return true;
+}
+
+// One event class: any of its literals anywhere in the message is a match,
+// unless one of its exclusions is in there too.
+class KmsgClass {
+public:
+    KmsgClass(std::string name, std::vector<std::string> literals, std::vector<std::string> excludes = {})
+        : name_(std::move(name)), literals_(std::move(literals)), excludes_(std::move(excludes)) {
+        for (const auto& literal : literals_) searchers_.emplace_back(literal.begin(), literal.end());
+    }
+
+    const std::string& name() const { return name_; }
+
+    bool matches(std::string_view message) const {
+        for (const auto& searcher : searchers_) {
+            if (std::search(message.begin(), message.end(), searcher) != message.end()) return true;
+        }
+        return false;
+    }
+
+    // Only asked about matching records, which are rare; a plain find is enough.
+    bool excluded(std::string_view message) const {
+        for (const auto& exclude : excludes_) {
+            if (message.find(exclude) != std::string_view::npos) return true;
+        }
+        return false;
+    }
+
+private:
+    std::string name_;
+    std::vector<std::string> literals_;  // the searchers point into these
+    std::vector<std::string> excludes_;
+    std::vector<std::boyer_moore_horspool_searcher<std::string::const_iterator>> searchers_;
+};
+
+// What we page on; the first matching class wins, so the specific ones come first.
+inline std::vector<std::unique_ptr<KmsgClass>> default_kmsg_classes() {
+    std::vector<std::unique_ptr<KmsgClass>> classes;
+    auto add = [&](const char* name, std::vector<std::string> literals, std::vector<std::string> excludes = {}) {
+        classes.push_back(std::make_unique<KmsgClass>(name, std::move(literals), std::move(excludes)));
+    };
+    add("oom_kill", {"Out of memory: Killed process", "oom-kill:", "Memory cgroup out of memory"});
+    add("hung_task", {"blocked for more than"});
+    add("soft_lockup", {"soft lockup - CPU", "hard LOCKUP", "rcu_sched self-detected stall", "rcu: INFO: rcu_"});
+    add("disk_error", {"I/O error", "critical medium error", "blk_update_request", "EXT4-fs error",
+                       "XFS: Internal error", "exception Emask", "controller is down"},
+        {"dev fd0", "dev sr0", "dev sr1"});  // drives probed for media at boot
+    add("fs_readonly", {"Remounting filesystem read-only", "remounting filesystem read-only"});
+    add("mce", {"Machine check", "mce: [Hardware Error]", "HANDLING MCE MEMORY ERROR", " CE memory", " UE memory"});
+    add("kernel_bug", {"kernel BUG at", "BUG: ", "WARNING: CPU:", "general protection fault", "Oops"});
+    add("segfault", {" segfault at ", "traps: "});
+    add("link_down", {"NETDEV WATCHDOG", "Link is Down"});  // not "link down": ataN prints it for every empty port
+    return classes;
+}
+
+class KmsgMonitor {
+public:
+    KmsgMonitor() : classes_(default_kmsg_classes()), counts_(classes_.size()) {}
+    ~KmsgMonitor() {
+        if (fd_ >= 0) close(fd_);
+        if (stop_fd_ >= 0) close(stop_fd_);
+    }
+    KmsgMonitor(const KmsgMonitor&) = delete;
+    KmsgMonitor& operator=(const KmsgMonitor&) = delete;
+
+    // Opens /dev/kmsg and positions it after the persisted sequence; false if kmsg is unreadable.
+    bool open_source(std::string state_file, const char* path = "/dev/kmsg") {
+        state_file_ = std::move(state_file);
+        fd_ = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        stop_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (fd_ < 0 || stop_fd_ < 0) return false;
+        boot_id_ = read_boot_id();
+
+        std::string saved_boot;
+        uint64_t saved_seq = 0;
+        bool have_state = load_state(saved_boot, saved_seq);
+        if (have_state && saved_boot == boot_id_) {
+            skip_through_ = saved_seq;  // the records up to here were handled by a previous run
+            lseek(fd_, 0, SEEK_SET);
+        } else if (have_state) {
+            lseek(fd_, 0, SEEK_SET);  // rebooted since: this boot's records are all new to us
+        } else {
+            lseek(fd_, 0, SEEK_END);  // first run: the boot log is history, not events
+        }
+        active_ = true;
+        return true;
+    }
+
+    bool active() const { return active_; }
+
+    void stop() {
+        if (stop_fd_ < 0) return;
+        uint64_t one = 1;
+        ssize_t ignored = write(stop_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    // Blocks until a record or stop(); every classified record is handed to emit at once.
+    void run(const std::atomic<bool>& running, const std::function<void(Reading&&)>& emit,
+             std::chrono::milliseconds persist_interval) {
+        std::cout << "[INFO] Kernel log monitor started." << std::endl;
+        char buf[8192];  // a kmsg record is at most ~1 KB of text plus dictionary
+        auto next_persist = std::chrono::steady_clock::now() + persist_interval;
+        uint64_t persisted = 0;
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        while (running) {
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n < 0 && errno == EPIPE) {
+                // We fell behind and the ring buffer overwrote records; the next read resumes at the oldest
+                lost_++;
+                continue;
+            }
+            if (n < 0 && errno == EAGAIN) {
+                if (last_seq_ != persisted) {
+                    save_state();
+                    persisted = last_seq_;
+                }
+                if (poll(fds, 2, -1) < 0 && errno != EINTR) break;
+                if (fds[1].revents) break;
+                continue;
+            }
+            if (n <= 0) break;
+            handle(std::string_view(buf, static_cast<size_t>(n)), emit);
+            // A burst persists at most once per interval; the idle path above catches the tail
+            if (std::chrono::steady_clock::now() >= next_persist && last_seq_ != persisted) {
+                save_state();
+                persisted = last_seq_;
+                next_persist = std::chrono::steady_clock::now() + persist_interval;
+            }
+        }
+        if (last_seq_ != persisted) save_state();
+        std::cout << "[INFO] Kernel log monitor exiting." << std::endl;
+    }
+
+    // Totals per class, plus records seen, matches suppressed by an exclusion and records lost to ring-buffer overruns.
+    Reading stats_reading() const {
+        Reading reading;
+        reading.sensor_id = "kmsg";
+        reading.timestamp = timestamp();
+        for (size_t i = 0; i < classes_.size(); ++i) {
+            reading.values.emplace_back(classes_[i]->name() + "_total", static_cast<double>(counts_[i].load()));
+        }
+        reading.values.emplace_back("records_total", static_cast<double>(records_.load()));
+        reading.values.emplace_back("errors_total", static_cast<double>(errors_.load()));
+        reading.values.emplace_back("suppressed_total", static_cast<double>(suppressed_.load()));
+        reading.values.emplace_back("overruns_total", static_cast<double>(lost_.load()));
+        return reading;
+    }
+
+private:
+    void handle(std::string_view text, const std::function<void(Reading&&)>& emit) {
+        KmsgRecord record;
+        if (!parse_kmsg_record(text, record)) return;
+        last_seq_ = record.sequence;
+        if (record.sequence <= skip_through_) return;
+        records_++;
+        if (record.priority <= 3) errors_++;
+        for (size_t i = 0; i < classes_.size(); ++i) {
+            if (!classes_[i]->matches(record.message)) continue;
+            if (classes_[i]->excluded(record.message)) {
+                suppressed_++;
+                break;
+            }
+            uint64_t total = ++counts_[i];
+            std::cout << "[WARN] kernel " << classes_[i]->name() << ": " << record.message << std::endl;
+            Reading reading;
+            reading.sensor_id = "kmsg_" + classes_[i]->name();
+            reading.timestamp = timestamp();
+            reading.values = {
+                {"priority", static_cast<double>(record.priority)},
+                {"sequence", static_cast<double>(record.sequence)},
+                {"uptime_s", record.usec / 1e6},
+                {"count_total", static_cast<double>(total)},
+            };
+            emit(std::move(reading));
+            break;
+        }
+    }
+
+    static std::string read_boot_id() {
+        std::ifstream in("/proc/sys/kernel/random/boot_id");
+        std::string id;
+        std::getline(in, id);
+        return id;
+    }
+
+    bool load_state(std::string& boot, uint64_t& seq) const {
+        if (state_file_.empty()) return false;
+        std::ifstream in(state_file_);
+        return static_cast<bool>(in >> boot >> seq);
+    }
+
+    // Written beside the target and renamed over it, so a crash never leaves half a file.
+    void save_state() const {
+        if (state_file_.empty()) return;
+        std::string tmp = state_file_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            out << boot_id_ << ' ' << last_seq_ << '\n';
+            if (!out) return;
+        }
+        std::rename(tmp.c_str(), state_file_.c_str());
+    }
+
+    std::vector<std::unique_ptr<KmsgClass>> classes_;
+    std::vector<std::atomic<uint64_t>> counts_;
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> suppressed_{0};
+    std::atomic<uint64_t> lost_{0};
+    int fd_ = -1;
+    int stop_fd_ = -1;
+    bool active_ = false;
+    std::string state_file_;
+    std::string boot_id_;
+
+    uint64_t skip_through_ = 0;
+    uint64_t last_seq_ = 0;
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+// Metrics from application logs: configured files are tailed and every
+// complete new line is checked against per-pattern substrings, giving counts
+// such as "5xx per second" without a separate grep pipeline.
+//
+// LOG_PATTERNS holds one "path|metric|pattern" entry per line. A pattern is a
+// literal substring, or "re:<ECMAScript regex>". A regex is only run on lines
+// that contain its longest literal run, so both kinds go through the same
+// prefilter. That prefilter compares 16 bytes at a time against the pattern's
+// first and last bytes with SSE2 (a scalar memchr loop elsewhere) and confirms
+// the few candidate positions with memcmp. Each matching line counts once per
+// pattern.
+//
+// Files are followed with inotify on their directories, so writes, rotation
+// by rename (the old file is drained, then the new one is opened from the
+// start) and copytruncate (the size drops below our offset) are all noticed
+// without polling the files. Counts go out as one "logs" reading per interval.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+// Offset of the first occurrence of needle in hay, or npos. needle must not be empty.
+inline size_t find_substring(std::string_view hay, std::string_view needle) {
+    const size_t n = needle.size();
+    if (n > hay.size()) return std::string_view::npos;
+    const char* h = hay.data();
+    const size_t last_start = hay.size() - n;  // highest valid start position
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[n - 1]);
+    for (; i + 16 <= last_start + 1; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + n - 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+        while (mask != 0) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (n <= 2 || std::memcmp(h + i + bit + 1, needle.data() + 1, n - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    // Tail (or the whole haystack without SSE2): memchr for the first byte, then verify
+    while (i <= last_start) {
+        const void* hit = std::memchr(h + i, needle[0], last_start - i + 1);
+        if (!hit) break;
+        i = static_cast<size_t>(static_cast<const char*>(hit) - h);
+        if (std::memcmp(h + i, needle.data(), n) == 0) return i;
+        i++;
+    }
+    return std::string_view::npos;
+}
+
+// The longest run of a regex that must appear literally in any match; empty if none is safe to use.
+inline std::string regex_literal(const std::string& regex) {
+    std::string best, run;
+    auto end_run = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+    int depth = 0;  // inside a group everything may be optional or alternated, so only depth 0 counts
+    for (size_t i = 0; i < regex.size(); ++i) {
+        char c = regex[i];
+        char next = i + 1 < regex.size() ? regex[i + 1] : '\0';
+        if (c == '|' && depth == 0) return "";  // top-level alternation: no single literal is required
+        if (c == '(') depth++;
+        if (c == ')') depth--;
+        bool meta = depth > 0 || std::strchr(".^$*+?()[]{}|\\", c) != nullptr;
+        // These quantifiers allow the preceding character to be absent ({0,n}), so it cannot be part of the run
+        bool optional = next != '\0' && std::strchr("*?{", next) != nullptr;
+        if (meta || optional) {
+            end_run();
+            // Skip an escape, a whole character class or a whole {m,n} bound
+            if (c == '\\') i++;
+            else if (c == '[') while (i < regex.size() && regex[i] != ']') i++;
+            else if (c == '{') while (i < regex.size() && regex[i] != '}') i++;
+            continue;
+        }
+        run += c;
+        if (next == '+') end_run();  // present at least once, but what follows it is not adjacent
+    }
+    end_run();
+    return best;
+}
+
+struct LogPattern {
+    std::string metric;
+    std::string literal;               // prefilter; the whole pattern for literal patterns
+    std::unique_ptr<std::regex> regex;  // confirmation for re: patterns
+    uint64_t matches = 0;               // lines matched this interval
+};
+
+// Counts lines of text (complete lines only) matching each pattern.
+inline void count_matches(std::string_view text, std::vector<LogPattern*>& patterns) {
+    for (LogPattern* pattern : patterns) {
+        std::string_view rest = text;
+        while (!rest.empty()) {
+            size_t hit = pattern->literal.empty() ? 0 : find_substring(rest, pattern->literal);
+            if (hit == std::string_view::npos) break;
+            size_t line_start = rest.rfind('\n', hit);
+            line_start = line_start == std::string_view::npos ? 0 : line_start + 1;
+            size_t line_end = rest.find('\n', hit);
+            if (line_end == std::string_view::npos) line_end = rest.size();
+            std::string_view line = rest.substr(line_start, line_end - line_start);
+            if (!pattern->regex || std::regex_search(line.begin(), line.end(), *pattern->regex)) pattern->matches++;
+            rest.remove_prefix(std::min(rest.size(), line_end + 1));
+        }
+    }
+}
+
+// One tailed file and the patterns that apply to it.
+class TailedFile {
+public:
+    TailedFile(std::string path, bool from_start) : path_(std::move(path)) { reopen(from_start); }
+    ~TailedFile() { if (fd_ >= 0) close(fd_); }
+    TailedFile(const TailedFile&) = delete;
+    TailedFile& operator=(const TailedFile&) = delete;
+
+    const std::string& path() const { return path_; }
+    std::string name() const { return path_.substr(path_.rfind('/') + 1); }
+
+    std::vector<LogPattern*> patterns;
+    uint64_t bytes = 0;  // scanned this interval
+
+    // Scans everything appended since the last call. Complete lines only; a partial line waits for its newline.
+    void consume() {
+        if (fd_ < 0) return;
+        struct stat st;
+        if (fstat(fd_, &st) == 0 && static_cast<uint64_t>(st.st_size) < offset_) {
+            offset_ = 0;  // truncated in place (copytruncate)
+            carry_.clear();
+        }
+        for (;;) {
+            size_t keep = carry_.size();
+            buf_.resize(keep + kChunk);
+            std::memcpy(buf_.data(), carry_.data(), keep);
+            ssize_t n = pread(fd_, buf_.data() + keep, kChunk, static_cast<off_t>(offset_));
+            if (n <= 0) break;
+            offset_ += static_cast<uint64_t>(n);
+            bytes += static_cast<uint64_t>(n);
+            std::string_view text(buf_.data(), keep + static_cast<size_t>(n));
+            size_t last_nl = text.rfind('\n');
+            if (last_nl == std::string_view::npos) {
+                carry_.assign(text.begin(), text.end());
+                if (carry_.size() > kMaxLine) carry_.clear();  // not a text log, or a runaway line
+                continue;
+            }
+            count_matches(text.substr(0, last_nl + 1), patterns);
+            carry_.assign(text.begin() + last_nl + 1, text.end());
+            if (static_cast<size_t>(n) < kChunk) break;
+        }
+    }
+
+    // The path now names a different file (rotation): finish the old one, then follow the new from its start.
+    void rotated() {
+        consume();
+        carry_.clear();
+        reopen(true);
+    }
+
+private:
+    static constexpr size_t kChunk = 1 << 20;
+    static constexpr size_t kMaxLine = 1 << 20;
+
+    void reopen(bool from_start) {
+        if (fd_ >= 0) close(fd_);
+        fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        offset_ = 0;
+        struct stat st;
+        if (!from_start && fd_ >= 0 && fstat(fd_, &st) == 0) offset_ = static_cast<uint64_t>(st.st_size);
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t offset_ = 0;
+    std::vector<char> buf_;
+    std::vector<char> carry_;
+};
+
+// "path|metric|pattern" lines; false (with the bad entry logged) on a malformed spec.
+inline bool parse_log_patterns(const std::string& spec, std::vector<std::unique_ptr<LogPattern>>& patterns,
+                               std::vector<std::unique_ptr<TailedFile>>& files) {
+    std::map<std::string, TailedFile*> by_path;
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t end = spec.find('\n', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string entry = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (entry.find_first_not_of(" \t\r") == std::string::npos) continue;
+        size_t bar1 = entry.find('|');
+        size_t bar2 = bar1 == std::string::npos ? std::string::npos : entry.find('|', bar1 + 1);
+        if (bar2 == std::string::npos || bar2 + 1 >= entry.size()) {
+            std::cerr << "[ERROR] LOG_PATTERNS entry '" << entry << "' is not path|metric|pattern" << std::endl;
+            return false;
+        }
+        auto pattern = std::make_unique<LogPattern>();
+        pattern->metric = entry.substr(bar1 + 1, bar2 - bar1 - 1);
+        std::string text = entry.substr(bar2 + 1);
+        if (text.rfind("re:", 0) == 0) {
+            try {
+                pattern->regex = std::make_unique<std::regex>(text.substr(3), std::regex::ECMAScript | std::regex::optimize);
+            } catch (const std::regex_error& e) {
+                std::cerr << "[ERROR] Bad regex in LOG_PATTERNS entry '" << entry << "': " << e.what() << std::endl;
+                return false;
+            }
+            pattern->literal = regex_literal(text.substr(3));
+        } else {
+            pattern->literal = text;
+        }
+        std::string path = entry.substr(0, bar1);
+        TailedFile*& file = by_path[path];
+        if (!file) {
+            files.push_back(std::make_unique<TailedFile>(path, false));
+            file = files.back().get();
+        }
+        file->patterns.push_back(pattern.get());
+        patterns.push_back(std::move(pattern));
+    }
+    return true;
+}
+
+inline void log_tail_thread(const std::atomic<bool>& running, ReadingQueue& out, std::string spec,
+                            std::chrono::milliseconds interval) {
+    std::vector<std::unique_ptr<LogPattern>> patterns;
+    std::vector<std::unique_ptr<TailedFile>> files;
+    if (!parse_log_patterns(spec, patterns, files) || files.empty()) return;
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    std::unordered_map<int, std::vector<TailedFile*>> by_dir;  // watch on each file's directory
+    for (auto& file : files) {
+        size_t slash = file->path().rfind('/');
+        std::string dir = slash == std::string::npos ? "." : file->path().substr(0, std::max<size_t>(slash, 1));
+        int wd = inotify_add_watch(inotify_fd, dir.c_str(), IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE);
+        if (wd < 0) std::cerr << "[WARN] Cannot watch " << dir << " for " << file->path() << std::endl;
+        else by_dir[wd].push_back(file.get());
+    }
+    std::cout << "[INFO] Log tail thread started (" << files.size() << " files, " << patterns.size() << " patterns)." << std::endl;
+
+    alignas(inotify_event) char events[8192];
+    auto last_publish = std::chrono::steady_clock::now();
+    auto next_publish = last_publish + interval;
+    while (running) {
+        // Blocks until something changes in a watched directory or the interval ends
+        int wait_ms = static_cast<int>(std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                                  next_publish - std::chrono::steady_clock::now()).count()));
+        pollfd pfd{inotify_fd, POLLIN, 0};
+        if (poll(&pfd, 1, std::min(wait_ms, 1000)) > 0) {
+            ssize_t n;
+            while ((n = read(inotify_fd, events, sizeof(events))) > 0) {
+                for (char* p = events; p < events + n;) {
+                    auto* event = reinterpret_cast<inotify_event*>(p);
+                    p += sizeof(inotify_event) + event->len;
+                    auto it = by_dir.find(event->wd);
+                    if (it == by_dir.end() || event->len == 0) continue;
+                    for (TailedFile* file : it->second) {
+                        if (file->name() != event->name) continue;
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO)) file->rotated();
+                        else file->consume();
+                    }
+                }
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_publish) continue;
+        double seconds = std::chrono::duration<double>(now - last_publish).count();
+        last_publish = now;
+        next_publish = now + interval;
+
+        Reading reading;
+        reading.sensor_id = "logs";
+        reading.timestamp = timestamp();
+        std::map<std::string, uint64_t> per_metric;  // several files or patterns may feed one metric
+        for (auto& pattern : patterns) {
+            per_metric[pattern->metric] += pattern->matches;
+            pattern->matches = 0;
+        }
+        for (const auto& [metric, count] : per_metric) {
+            reading.values.emplace_back(metric + "_per_sec", seconds > 0 ? count / seconds : 0.0);
+        }
+        uint64_t bytes = 0;
+        for (auto& file : files) {
+            bytes += file->bytes;
+            file->bytes = 0;
+        }
+        reading.values.emplace_back("bytes_scanned_per_sec", seconds > 0 ? bytes / seconds : 0.0);
+        out.push(std::move(reading));
+    }
+    if (inotify_fd >= 0) close(inotify_fd);
+    std::cout << "[INFO] Log tail thread exiting." << std::endl;
+}
@@ -0,0 +1,634 @@
+// Microbenchmarks for the agent's hot paths.
+//
+//   ./microbench                 run every benchmark
+//   ./microbench json tasks      run the named ones
+//   ./microbench --iterations N  scale the work (default 200000)
+//
+// Each benchmark checks that the optimised path produces the same result as
+// the straightforward one before timing both; "probes" only checks outcome
+// counts against loopback stand-ins.
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include "wire.hpp"
+#include "process_scan.hpp"
+#include "task_pool.hpp"
+#include "vmstat.hpp"
+#include "irq_dist.hpp"
+#include "log_tail.hpp"
+#include "derived.hpp"
+#include "delta.hpp"
+#include "probes.hpp"
+#include <poll.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps results alive so the optimiser cannot drop the measured work.
+static volatile size_t g_sink;
+
+// Nanoseconds per call of fn, best of three runs.
+static double time_ns(long iterations, const std::function<void()>& fn) {
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run) {
+        auto start = Clock::now();
+        for (long i = 0; i < iterations; ++i) fn();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+        if (run == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+static void report(const std::string& name, double baseline_ns, double optimised_ns) {
+    std::cout << "  " << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << baseline_ns << " ns" << std::setw(10) << optimised_ns << " ns"
+              << std::setw(8) << baseline_ns / optimised_ns << "x" << std::endl;
+}
+
+// ---- json: nlohmann tree + dump() against the streaming ReadingEncoder ------
+
+// Same bytes as nlohmann, or, where grisu2 emits a longer or different last digit
+// than the shortest round trip, the same document once parsed.
+static long g_json_digit_differences = 0;
+
+static bool json_matches(ReadingEncoder& encoder, const Reading& reading, const AgentIdentity& id) {
+    std::string streamed;
+    encoder.append(streamed, reading, id);
+    std::string reference = reading_json(reading, id).dump();
+    if (streamed == reference) return true;
+    if (nlohmann::json::parse(streamed) == nlohmann::json::parse(reference)) {
+        g_json_digit_differences++;
+        return true;
+    }
+    std::cerr << "[ERROR] JSON mismatch\n  nlohmann: " << reference << "\n  streamed: " << streamed << std::endl;
+    return false;
+}
+
+static bool bench_json(long iterations) {
+    AgentIdentity id{"edge-017", {{"rack", "r4"}, {"dc", "eu-west"}}};
+    Reading cpu{"cpu_usage_01", timestamp(), {{"cpu_usage_percent", 37.25}}, true};
+    Reading timer{"statsd.http.latency", timestamp(),
+                  {{"count", 1250}, {"mean", 12.0625}, {"min", 0.4}, {"max", 381.5},
+                   {"p50", 8.75}, {"p90", 30.125}, {"p99", 212.0}}, true};
+    Reading wide{"vmstat", timestamp(), {}, true};
+    for (int i = 0; i < 40; ++i) wide.values.emplace_back("counter_" + std::to_string(i), 48611.0 * i * i + 7);
+
+    // Formatting must match nlohmann on awkward doubles, not just the fixtures
+    ReadingEncoder encoder;
+    std::mt19937_64 rng(42);
+    Reading probe{"probe", timestamp(), {{"v", 0.0}}, false};
+    const double specials[] = {0.0, -0.0, 1.0, -1.5, 1e15, -1e15, 1e16, 999999999999999.0, -123456789012345.0,
+                               1e-4, 1e-5, 0.1, 1.0 / 3,
+                               5e-324, 1.7976931348623157e308, NAN, INFINITY, -INFINITY, 100.0, 2.5e-7};
+    for (double v : specials) {
+        probe.values[0].second = v;
+        if (!json_matches(encoder, probe, id)) return false;
+    }
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t bits = rng();
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        if (i % 3 == 1) v = std::ldexp(static_cast<double>(rng() % 1000000), static_cast<int>(rng() % 60) - 30);
+        if (i % 3 == 2) v = static_cast<double>(static_cast<int64_t>(rng() >> (rng() % 64)));
+        probe.values[0].second = v;
+        if (!json_matches(encoder, probe, id)) return false;
+    }
+    AgentIdentity odd{"host \"quoted\"\n", {{"z", "last"}, {"a", "tab\there"}}};
+    Reading clash{"cpu\\01", timestamp(), {{"sensor_id", 1.0}, {"b", 2.0}, {"b", 3.0}}, true};
+    if (!json_matches(encoder, clash, odd) || !json_matches(encoder, wide, id)) return false;
+
+    // A sensor whose key set changes on every reading must neither grow the layout cache nor slow down
+    Reading shifting{"shifting", timestamp(), {}, true};
+    auto reshape = [&] {
+        shifting.values.clear();
+        for (int k = 0; k < 20; ++k) shifting.values.emplace_back("k" + std::to_string(rng() % 64), k * 1.5);
+    };
+    for (int i = 0; i < 2000; ++i) {
+        reshape();
+        if (!json_matches(encoder, shifting, id)) return false;
+    }
+
+    std::cout << "json: output checked against nlohmann, " << g_json_digit_differences
+              << " of 200000+ random doubles differ only in equivalent digits" << std::endl;
+    std::cout << "json (per reading)               nlohmann  streaming  speedup" << std::endl;
+    std::string buf;
+    for (const auto* reading : {&cpu, &timer, &wide}) {
+        double tree = time_ns(iterations, [&] { g_sink = reading_json(*reading, id).dump().size(); });
+        double streamed = time_ns(iterations, [&] {
+            buf.clear();
+            encoder.append(buf, *reading, id);
+            g_sink = buf.size();
+        });
+        report(reading->sensor_id + " (" + std::to_string(reading->values.size()) + " values)", tree, streamed);
+    }
+    {
+        std::vector<Reading> shapes;
+        for (int i = 0; i < 1024; ++i) {
+            reshape();
+            shapes.push_back(shifting);
+        }
+        size_t next = 0;
+        double tree = time_ns(iterations, [&] { g_sink = reading_json(shapes[next++ % shapes.size()], id).dump().size(); });
+        double streamed = time_ns(iterations, [&] {
+            buf.clear();
+            encoder.append(buf, shapes[next++ % shapes.size()], id);
+            g_sink = buf.size();
+        });
+        report("shifting (20 values, new keys)", tree, streamed);
+    }
+    std::vector<Reading> batch(500, cpu);
+    double tree = time_ns(iterations / 500 + 1, [&] {
+        nlohmann::json array = nlohmann::json::array();
+        for (const auto& reading : batch) array.push_back(reading_json(reading, id));
+        g_sink = array.dump().size();
+    }) / batch.size();
+    double streamed = time_ns(iterations / 500 + 1, [&] {
+        buf.clear();
+        encoder.append_batch(buf, batch, id);
+        g_sink = buf.size();
+    }) / batch.size();
+    report("batch of 500", tree, streamed);
+    return true;
+}
+
+// ---- tasks: process scan and a CPU-bound split across 1..N pool workers ------
+
+static bool bench_tasks(long iterations) {
+    TaskPool serial(1);
+    ProcessTotals expected = scan_processes(serial);
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "tasks: " << expected.processes << " processes, " << cores << " cores" << std::endl;
+
+    // Synthetic work with no syscalls shows the pool's own scaling and overhead
+    auto spin = [](size_t i) {
+        uint64_t x = i + 1;
+        for (int k = 0; k < 20000; ++k) x = x * 6364136223846793005ull + 1442695040888963407ull;
+        g_sink = static_cast<size_t>(x);
+    };
+    std::cout << "  workers   scan_ms  speedup  cpu_tasks_ms  speedup  steals" << std::endl;
+    long reps = std::max(1L, iterations / 20000);
+    double scan_base = 0.0, cpu_base = 0.0;
+    for (unsigned workers = 1; workers <= std::max(cores * 2, 2u); workers *= 2) {
+        TaskPool pool(workers);
+        double scan_ms = time_ns(reps, [&] { g_sink = scan_processes(pool).processes; }) / 1e6;
+        double cpu_ms = time_ns(reps, [&] { pool.parallel_for(256, spin); }) / 1e6;
+        if (workers == 1) {
+            scan_base = scan_ms;
+            cpu_base = cpu_ms;
+        }
+        std::cout << std::fixed << std::setprecision(2) << std::setw(9) << workers << std::setw(10) << scan_ms
+                  << std::setw(8) << scan_base / scan_ms << "x" << std::setw(13) << cpu_ms << std::setw(8)
+                  << cpu_base / cpu_ms << "x" << std::setw(8) << pool.steals() << std::endl;
+    }
+    return expected.processes > 0;
+}
+
+// ---- vmstat: line-map parse against comparing every key on every read -------
+
+static bool bench_vmstat(long iterations) {
+    VmstatReader reader;
+    VmstatSample mapped;
+    if (!reader.read(mapped)) return false;
+
+    // Straightforward parse of the same text: split every line, classify its key
+    std::vector<char> buf(16384);
+    int fd = open("/proc/vmstat", O_RDONLY | O_CLOEXEC);
+    ssize_t n = pread(fd, buf.data(), buf.size(), 0);
+    close(fd);
+    std::string_view text(buf.data(), n > 0 ? static_cast<size_t>(n) : 0);
+    auto naive = [&](VmstatSample& out) {
+        for (auto& c : out.counters) c = 0;
+        std::string_view rest = text;
+        while (!rest.empty()) {
+            size_t nl = rest.find('\n');
+            std::string_view row = rest.substr(0, nl);
+            rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+            size_t space = row.find(' ');
+            int counter = space == std::string_view::npos ? -1 : vmstat_counter_for(row.substr(0, space));
+            uint64_t value = 0;
+            if (counter >= 0) std::from_chars(row.data() + space + 1, row.data() + row.size(), value);
+            if (counter >= 0) out.counters[counter] += value;
+        }
+    };
+    VmstatSample check;
+    naive(check);
+    reader.parse(text, mapped);
+    for (int c = 0; c < VmstatSample::kCounters; ++c) {
+        if (check.counters[c] != mapped.counters[c]) {
+            std::cerr << "[ERROR] vmstat counter " << c << " differs: " << check.counters[c] << " vs " << mapped.counters[c] << std::endl;
+            return false;
+        }
+    }
+
+    long reps = std::max(1L, iterations / 20);
+    VmstatSample out;
+    double by_key = time_ns(reps, [&] { naive(out); g_sink = out.counters[0]; });
+    double by_line = time_ns(reps, [&] { reader.parse(text, out); g_sink = out.counters[0]; });
+    double full_read = time_ns(reps, [&] { reader.read(out); g_sink = out.counters[0]; });
+    std::cout << "vmstat (parse only)              by key   line map  speedup" << std::endl;
+    report("/proc/vmstat text", by_key, by_line);
+    std::cout << "  a full tick (two preads + parse) takes " << std::fixed << std::setprecision(1) << full_read
+              << " ns, mostly the kernel formatting the files" << std::endl;
+    return true;
+}
+
+// ---- irq: flat matrix parse + delta against line-by-line stream parsing ------
+
+// A /proc/interrupts of the size the sensor has to cope with: 128 CPUs, 300 lines.
+static std::string synthetic_interrupts(size_t cpus, size_t lines, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string text(11, ' ');
+    for (size_t c = 0; c < cpus; ++c) text += "CPU" + std::to_string(c) + std::string(c < 10 ? 7 : 6, ' ');
+    text += "\n";
+    for (size_t l = 0; l < lines; ++l) {
+        std::string label = l + 8 < lines ? std::to_string(l + 24) : std::string("NMI LOC SPU PMI IWI RTR RES CAL").substr((l + 8 - lines) * 4, 3);
+        text += std::string(label.size() < 4 ? 4 - label.size() : 0, ' ') + label + ":";
+        for (size_t c = 0; c < cpus; ++c) {
+            uint32_t v = rng() % 4 == 0 ? rng() % 100000000 : 0;
+            std::string n = std::to_string(v);
+            text += std::string(n.size() < 10 ? 11 - n.size() : 1, ' ') + n;
+        }
+        text += l + 8 < lines ? "  IR-PCI-MSI 524288-edge      eth0-TxRx-" + std::to_string(l) + "\n" : "   Local timer interrupts\n";
+    }
+    return text;
+}
+
+static bool bench_irq(long iterations) {
+    const size_t cpus = 128, lines = 300;
+    std::string before = synthetic_interrupts(cpus, lines, 1);
+    std::string after = synthetic_interrupts(cpus, lines, 2);
+
+    // Straightforward version: stream every line into a per-label vector, diff by label
+    using Table = std::map<std::string, std::vector<uint64_t>>;
+    auto naive_parse = [&](const std::string& text, Table& table) {
+        std::istringstream in(text);
+        std::string line;
+        std::getline(in, line);
+        while (std::getline(in, line)) {
+            std::istringstream row(line);
+            std::string label;
+            row >> label;
+            for (char& ch : label) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+            auto& cells = table[label.substr(0, label.size() - 1)];
+            cells.assign(cpus, 0);
+            for (size_t c = 0; c < cpus && row >> cells[c]; ++c) {
+            }
+        }
+    };
+    auto naive_tick = [&](const Table& prev, Table& cur, const std::string& text, std::map<std::string, uint64_t>& out) {
+        naive_parse(text, cur);
+        out.clear();
+        for (const auto& [label, cells] : cur) {
+            const auto& old = prev.at(label);
+            for (size_t c = 0; c < cpus; ++c) {
+                if (cells[c] != old[c]) out[label + "_cpu" + std::to_string(c)] = static_cast<uint32_t>(cells[c] - old[c]);
+            }
+        }
+    };
+
+    IrqTableReader reader("/dev/null");
+    IrqMatrix prev, cur;
+    std::vector<uint32_t> deltas;
+    auto flat_tick = [&](const std::string& text) {
+        reader.parse(text.data(), text.size(), cur);
+        irq_deltas(prev, cur, deltas);
+    };
+    Table table_prev, table_cur;
+    std::map<std::string, uint64_t> expected;
+    naive_parse(before, table_prev);
+    naive_tick(table_prev, table_cur, after, expected);
+    reader.parse(before.data(), before.size(), prev);
+    flat_tick(after);
+    IrqActiveRows active, dense_active;
+    Reading sparse = irq_reading("interrupts", cur, deltas, 1.0, active, false);
+    Reading dense = irq_reading("interrupts", cur, deltas, 1.0, dense_active, true);
+    size_t cells = 0, stray = 0;
+    for (const auto& [name, value] : sparse.values) {
+        auto it = expected.find(name);
+        if (it != expected.end() && static_cast<double>(it->second) == value) cells++;
+        else if (name.find("_cpu") != std::string::npos && name != "top_cpu_share") stray++;
+    }
+    for (const auto& [name, value] : dense.values) {
+        auto it = expected.find(name);
+        if (it == expected.end() && name.find("_cpu") != std::string::npos && name != "top_cpu_share" && value != 0) stray++;
+    }
+    // Dense: a tick with nothing new keeps the same names, every cell now an explicit zero
+    irq_deltas(cur, cur, deltas);
+    Reading quiet = irq_reading("interrupts", cur, deltas, 1.0, dense_active, true);
+    bool stable = quiet.values.size() == dense.values.size();
+    for (size_t i = 0; stable && i < quiet.values.size(); ++i) {
+        stable = quiet.values[i].first == dense.values[i].first && (quiet.values[i].second == 0 || quiet.values[i].first == "top_cpu_share");
+    }
+    flat_tick(after);
+    if (prev.layout != cur.layout || cells != expected.size() || stray != 0 || !stable) {
+        std::cerr << "[ERROR] irq deltas differ: " << cells << " of " << expected.size() << " cells match" << std::endl;
+        return false;
+    }
+
+    long reps = std::max(1L, iterations / 1000);
+    double by_stream = time_ns(reps, [&] { naive_tick(table_prev, table_cur, after, expected); g_sink = expected.size(); });
+    double by_matrix = time_ns(reps, [&] { flat_tick(after); g_sink = deltas[0]; });
+    double publish = time_ns(reps, [&] { g_sink = irq_reading("interrupts", cur, deltas, 1.0, active, false).values.size(); });
+    std::cout << "irq (parse + delta)              stream   flat     speedup" << std::endl;
+    report("128 CPUs x 300 lines", by_stream, by_matrix);
+    std::cout << "  building the sparse reading (" << sparse.values.size() << " values; dense " << dense.values.size()
+              << ") takes " << std::fixed
+              << std::setprecision(1) << publish << " ns" << std::endl;
+    return true;
+}
+
+// ---- logs: SSE2 prefiltered line counting against a per-line find ------------
+
+static bool bench_logs(long iterations) {
+    // ~32 MB of access-log lines, 1 in 50 a 5xx and 1 in 200 a slow request
+    std::mt19937 rng(7);
+    std::string text;
+    const char* paths[] = {"/api/v1/orders", "/static/app.js", "/api/v2/users/42", "/healthz", "/login"};
+    while (text.size() < (32u << 20)) {
+        unsigned r = rng() % 200;
+        int status = r < 4 ? 503 : r < 20 ? 404 : 200;
+        text += "10.0.";
+        text += std::to_string(rng() % 256) + "." + std::to_string(rng() % 256);
+        text += " - - [18/Oct/2026:14:23:53 +0000] \"GET ";
+        text += paths[rng() % 5];
+        text += " HTTP/1.1\" " + std::to_string(status) + " " + std::to_string(rng() % 50000);
+        text += r == 7 ? " \"-\" \"curl/8.4\" upstream_timeout\n" : " \"-\" \"Mozilla/5.0 (X11; Linux x86_64)\"\n";
+    }
+
+    // The re: prefilter must be a substring of every line the regex matches
+    const struct { const char* regex; const char* literal; const char* line; } prefilters[] = {
+        {"a{2,3}b", "b", "xaab"},
+        {"[0-9]{1,3}\\.[0-9]{1,3}\\.", "", "10.0.3.7"},
+        {"GET /api/v[12]/users/[0-9]+ ", "GET /api/v", "\"GET /api/v2/users/42 HTTP/1.1\""},
+        {"ab+c", "ab", "abbbc"},
+        {"upstream_(timeout|reset)", "upstream_", "502 upstream_reset"},
+        {"slow: x*query", "slow: ", "slow: query"},
+        {"\\d{3} ms$", " ms", "took 250 ms"},
+        {"error|fatal", "", "fatal: disk"},
+    };
+    for (const auto& p : prefilters) {
+        std::string literal = regex_literal(p.regex);
+        if (literal != p.literal || !std::regex_search(p.line, std::regex(p.regex)) ||
+            std::string_view(p.line).find(literal) == std::string_view::npos) {
+            std::cerr << "[ERROR] prefilter for re:" << p.regex << " is '" << literal << "', want '" << p.literal << "'" << std::endl;
+            return false;
+        }
+    }
+
+    LogPattern five_xx, slow;
+    five_xx.literal = "\" 503 ";
+    slow.literal = "upstream_timeout";
+    std::vector<LogPattern*> patterns = {&five_xx, &slow};
+    auto naive = [&](uint64_t* counts) {
+        counts[0] = counts[1] = 0;
+        std::string_view rest = text;
+        while (!rest.empty()) {
+            size_t nl = rest.find('\n');
+            std::string_view line = rest.substr(0, nl);
+            rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+            for (int p = 0; p < 2; ++p) {
+                if (line.find(patterns[p]->literal) != std::string_view::npos) counts[p]++;
+            }
+        }
+    };
+    uint64_t expected[2];
+    naive(expected);
+    count_matches(text, patterns);
+    if (five_xx.matches != expected[0] || slow.matches != expected[1]) {
+        std::cerr << "[ERROR] log match counts differ: " << five_xx.matches << "/" << slow.matches << " vs "
+                  << expected[0] << "/" << expected[1] << std::endl;
+        return false;
+    }
+
+    long reps = std::max(1L, iterations / 100000);
+    double by_line = time_ns(reps, [&] { naive(expected); g_sink = expected[0]; });
+    double by_simd = time_ns(reps, [&] { count_matches(text, patterns); g_sink = five_xx.matches; });
+    double mb = text.size() / 1e6;
+    std::cout << "logs (2 patterns, " << static_cast<int>(mb) << " MB)       per line  prefilter speedup" << std::endl;
+    report("match counting", by_line, by_simd);
+    std::cout << std::fixed << std::setprecision(0) << "  " << mb / (by_line / 1e9) << " MB/s per line, "
+              << mb / (by_simd / 1e9) << " MB/s prefiltered" << std::endl;
+    return true;
+}
+
+// ---- derived: compiled postfix programs against a closure tree over named values
+
+static bool bench_derived(long iterations) {
+    const char* definitions[] = {
+        "proc_stat.cpu_busy_percent = proc_stat.cpu_user_percent + proc_stat.cpu_system_percent",
+        "net_stack.retrans_ratio = net_stack.tcp_retrans_segs_per_sec / max(net_stack.tcp_out_segs_per_sec, 1)",
+        "vmstat.pressure = (vmstat.load1 - vmstat.cpus) / vmstat.cpus * 100 + abs(-vmstat.procs_blocked) * 0.5",
+    };
+    auto stage = make_derived_stage(std::string(definitions[0]) + ";" + definitions[1] + ";" + definitions[2]);
+    if (!stage) return false;
+    std::vector<Reading> batch = {
+        {"proc_stat", timestamp(), {{"cpu_user_percent", 31.5}, {"cpu_system_percent", 7.25}}, true},
+        {"net_stack", timestamp(), {{"tcp_retrans_segs_per_sec", 3.0}, {"tcp_out_segs_per_sec", 1250.0}}, true},
+        {"vmstat", timestamp(), {{"load1", 5.5}, {"cpus", 4.0}, {"procs_blocked", 3.0}}, true},
+    };
+    stage->process(batch);
+
+    // The straightforward version: a tree of closures looking values up by name
+    std::unordered_map<std::string, double> named;
+    for (size_t r = 0; r < 3; ++r) {
+        for (const auto& [key, value] : batch[r].values) named[batch[r].sensor_id + "." + key] = value;
+    }
+    using Node = std::function<double()>;
+    auto ref = [&](const char* name) -> Node { return [&named, key = std::string(name)] { return named.at(key); }; };
+    auto num = [](double v) -> Node { return [v] { return v; }; };
+    auto bin = [](Node a, Node b, char op) -> Node {
+        return [a, b, op] {
+            double x = a(), y = b();
+            return op == '+' ? x + y : op == '-' ? x - y : op == '*' ? x * y : op == '/' ? x / y : std::max(x, y);
+        };
+    };
+    std::vector<Node> trees = {
+        bin(ref("proc_stat.cpu_user_percent"), ref("proc_stat.cpu_system_percent"), '+'),
+        bin(ref("net_stack.tcp_retrans_segs_per_sec"), bin(ref("net_stack.tcp_out_segs_per_sec"), num(1), 'M'), '/'),
+        bin(bin(bin(bin(ref("vmstat.load1"), ref("vmstat.cpus"), '-'), ref("vmstat.cpus"), '/'), num(100), '*'),
+            bin([&] { return std::fabs(-named.at("vmstat.procs_blocked")); }, num(0.5), '*'), '+'),
+    };
+    for (size_t i = 0; i < trees.size(); ++i) {
+        if (stage->evaluate(i) != trees[i]()) {
+            std::cerr << "[ERROR] derived metric " << i << " differs: " << stage->evaluate(i) << " vs " << trees[i]() << std::endl;
+            return false;
+        }
+    }
+    std::cout << "derived (per evaluation)         closures compiled speedup" << std::endl;
+    for (size_t i = 0; i < trees.size(); ++i) {
+        double tree = time_ns(iterations, [&] { g_sink = static_cast<size_t>(trees[i]()); });
+        double compiled = time_ns(iterations, [&] { g_sink = static_cast<size_t>(stage->evaluate(i)); });
+        report(std::string(definitions[i]).substr(0, std::string(definitions[i]).find(' ')), tree, compiled);
+    }
+    return true;
+}
+
+// ---- delta: full JSON objects against delta encoding for a wide table ----------
+
+static bool bench_delta(long iterations) {
+    // A 512-value per-process table where a few values move each tick
+    AgentIdentity id{"edge-017", {{"rack", "r4"}}};
+    Reading table{"processes", timestamp(), {}, true};
+    for (int i = 0; i < 512; ++i) table.values.emplace_back("pid" + std::to_string(1000 + i) + "_rss_bytes", 4096.0 * (i + 1));
+    std::mt19937 rng(3);
+    ReadingEncoder full;
+    DeltaEncoder delta(30);
+    std::string buf;
+    std::map<std::string, double> state;
+    std::cout << "delta (512-value reading)        full     delta    ratio" << std::endl;
+    for (int changed : {0, 5, 50, 512}) {
+        size_t full_bytes = 0, delta_bytes = 0;
+        const int ticks = 300;
+        for (int tick = 0; tick < ticks; ++tick) {
+            for (int c = 0; c < changed; ++c) table.values[rng() % 512].second += 4096;
+            buf.clear();
+            full.append(buf, table, id);
+            full_bytes += buf.size();
+            buf.clear();
+            delta.append(buf, table, id);
+            delta_bytes += buf.size();
+            // Apply it the way the processor does and check nothing was lost
+            nlohmann::json message = nlohmann::json::parse(buf);
+            if (message["delta"]["keyframe"].get<bool>()) state.clear();
+            for (const auto& [key, value] : message.items()) {
+                if (value.is_number()) state[key] = value.get<double>();
+            }
+            for (const auto& [key, value] : table.values) {
+                if (state[key] != value) {
+                    std::cerr << "[ERROR] delta state for " << key << " is " << state[key] << ", expected " << value << std::endl;
+                    return false;
+                }
+            }
+        }
+        std::cout << "  " << std::left << std::setw(28) << (std::to_string(changed) + " changed per tick") << std::right
+                  << std::setw(7) << full_bytes / ticks << " B" << std::setw(7) << delta_bytes / ticks << " B"
+                  << std::fixed << std::setprecision(1) << std::setw(8) << static_cast<double>(full_bytes) / delta_bytes << "x" << std::endl;
+    }
+    double by_full = time_ns(iterations / 100 + 1, [&] {
+        table.values[rng() % 512].second += 4096;
+        buf.clear();
+        full.append(buf, table, id);
+        g_sink = buf.size();
+    });
+    double by_delta = time_ns(iterations / 100 + 1, [&] {
+        table.values[rng() % 512].second += 4096;
+        buf.clear();
+        delta.append(buf, table, id);
+        g_sink = buf.size();
+    });
+    report("encode, 1 changed", by_full, by_delta);
+    return true;
+}
+
+// ---- probes: outcome counts against local stand-ins (a check only: loopback connects are too fast to time)
+
+// A listening socket on an ephemeral loopback port; -1 on failure.
+static int listen_local(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0 || listen(fd, 4096) != 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static bool bench_probes(long) {
+    // A bare listener, HTTP servers answering 200 and 404, one that accepts but never answers, and a closed port
+    uint16_t tcp_port = 0, healthy_port = 0, missing_port = 0, silent_port = 0, closed_port = 0;
+    int fds[5] = {listen_local(tcp_port), listen_local(healthy_port), listen_local(missing_port),
+                  listen_local(silent_port), listen_local(closed_port)};
+    if (std::count(fds, fds + 5, -1) > 0) {
+        std::cerr << "[ERROR] probes: cannot listen on loopback" << std::endl;
+        for (int fd : fds) if (fd >= 0) close(fd);
+        return false;
+    }
+    close(fds[4]);  // nothing listens there any more, so connects are refused
+    std::atomic<bool> serving{true};
+    std::thread server([&] {
+        pollfd polled[3] = {{fds[0], POLLIN, 0}, {fds[1], POLLIN, 0}, {fds[2], POLLIN, 0}};
+        const char* replies[3] = {nullptr, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n",
+                                  "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n"};
+        while (serving) {
+            if (poll(polled, 3, 50) <= 0) continue;
+            for (int i = 0; i < 3; ++i) {
+                if (!(polled[i].revents & POLLIN)) continue;
+                int conn = accept4(polled[i].fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (conn < 0) continue;
+                if (replies[i]) {
+                    char request[1024];
+                    ssize_t ignored = recv(conn, request, sizeof(request), 0);
+                    ignored = send(conn, replies[i], std::strlen(replies[i]), MSG_NOSIGNAL);
+                    (void)ignored;
+                }
+                close(conn);
+            }
+        }
+    });
+    auto local = [](const char* scheme, uint16_t port) { return std::string(scheme) + "127.0.0.1:" + std::to_string(port); };
+
+    ProbeRunner runner(parse_probe_targets({"listener=" + local("tcp:", tcp_port), "closed=" + local("tcp:", closed_port),
+                                            "healthy=" + local("http://", healthy_port) + "/healthz",
+                                            "missing=" + local("http://", missing_port) + "/nope",
+                                            "silent=" + local("http://", silent_port) + "/"}),
+                       std::chrono::milliseconds(300), 16);
+    const uint64_t want[5] = {2, 1, 1, 1, 0};  // ok, refused, timed_out, bad_status, error
+    uint64_t counts[5] = {};
+    bool ok = runner.ok();
+    for (int round = 0; ok && round < 3; ++round) {
+        runner.run_round(counts);
+        ok = std::equal(counts, counts + 5, want) && runner.targets()[3].last_status == 404;
+    }
+    if (!ok) {
+        std::cerr << "[ERROR] probe outcomes differ: ok/refused/timed_out/bad_status/error = " << counts[0] << "/"
+                  << counts[1] << "/" << counts[2] << "/" << counts[3] << "/" << counts[4] << ", want 2/1/1/1/0" << std::endl;
+    } else {
+        std::cout << "probes: 5 loopback stand-ins gave 2 ok, 1 refused, 1 timed out, 1 bad status in each of 3 rounds" << std::endl;
+    }
+    serving = false;
+    server.join();
+    for (int i = 0; i < 4; ++i) close(fds[i]);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    long iterations = 200000;
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = std::atol(argv[++i]);
+        else selected.emplace_back(argv[i]);
+    }
+
+    const std::map<std::string, std::function<bool(long)>> benchmarks = {
+        {"delta", bench_delta},
+        {"derived", bench_derived},
+        {"irq", bench_irq},
+        {"json", bench_json},
+        {"logs", bench_logs},
+        {"probes", bench_probes},
+        {"tasks", bench_tasks},
+        {"vmstat", bench_vmstat},
+    };
+    bool ok = true;
+    for (const auto& [name, fn] : benchmarks) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), name) == selected.end()) continue;
+        ok = fn(iterations) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+// Kernel network stack health from /proc/net/snmp and /proc/net/netstat:
+// every counter (retransmits, listen-queue overflows, UDP buffer errors, ...)
+// as a rate per second, delivered as one "net_stack" reading per tick.
+//
+// Both files come as line pairs, "Tcp: RtoAlgorithm RtoMin ..." followed by
+// "Tcp: 1 200 ...". The header lines are turned into a column map once; later
+// ticks skip them and read the value lines positionally into a flat array.
+// A value line whose prefix or column count no longer matches (IcmpMsg grows
+// a column when a new ICMP type is first seen) rebuilds the map and skips
+// one tick.
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+// "TcpExt" + "ListenOverflows" -> "tcpext_listen_overflows"; "TCPLostRetransmit" -> "tcp_lost_retransmit"
+inline std::string net_snmp_metric_name(std::string_view proto, std::string_view field) {
+    auto upper = [](char c) { return c >= 'A' && c <= 'Z'; };
+    auto lower = [](char c) { return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'); };
+    std::string name;
+    for (char c : proto) name += upper(c) ? static_cast<char>(c - 'A' + 'a') : c;
+    name += '_';
+    for (size_t i = 0; i < field.size(); ++i) {
+        char c = field[i];
+        if (upper(c) && i > 0 &&
+            (lower(field[i - 1]) || (upper(field[i - 1]) && i + 1 < field.size() && lower(field[i + 1])))) {
+            name += '_';
+        }
+        name += upper(c) ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    return name;
+}
+
+struct NetSnmpSample {
+    std::chrono::steady_clock::time_point taken;
+    std::vector<int64_t> values;  // one per mapped column, in file order
+    uint64_t layout = 0;
+};
+
+class NetSnmpReader {
+public:
+    enum class Kind { counter, gauge, config };
+    struct Column {
+        std::string name;
+        Kind kind;
+    };
+
+    NetSnmpReader(const char* snmp = "/proc/net/snmp", const char* netstat = "/proc/net/netstat")
+        : buf_(16384) {
+        for (const char* path : {snmp, netstat}) {
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) files_.push_back({fd, {}});
+        }
+    }
+    ~NetSnmpReader() {
+        for (auto& file : files_) close(file.fd);
+    }
+    NetSnmpReader(const NetSnmpReader&) = delete;
+    NetSnmpReader& operator=(const NetSnmpReader&) = delete;
+
+    bool read(NetSnmpSample& out) {
+        if (files_.empty()) return false;
+        out.taken = std::chrono::steady_clock::now();
+        size_t column = 0;
+        for (File& file : files_) {
+            std::string_view text = read_file(file.fd);
+            if (!parse_values(text, file, column, out)) {
+                build_map();
+                return false;
+            }
+        }
+        if (column != out.values.size()) out.values.resize(column);
+        out.layout = layout_;
+        return column > 0;
+    }
+
+    const std::vector<Column>& columns() const { return columns_; }
+
+private:
+    // One "Proto:" value line: where its values land in the flat array
+    struct Line {
+        std::string prefix;  // "Tcp:"
+        size_t columns;
+    };
+    struct File {
+        int fd;
+        std::vector<Line> lines;
+    };
+
+    std::string_view read_file(int fd) {
+        ssize_t n;
+        while ((n = pread(fd, buf_.data(), buf_.size(), 0)) == static_cast<ssize_t>(buf_.size())) {
+            buf_.resize(buf_.size() * 2);
+        }
+        return n > 0 ? std::string_view(buf_.data(), static_cast<size_t>(n)) : std::string_view();
+    }
+
+    // Reads every other line positionally; false when the text no longer fits the map.
+    bool parse_values(std::string_view text, const File& file, size_t& column, NetSnmpSample& out) {
+        if (file.lines.empty()) return false;
+        for (const Line& line : file.lines) {
+            size_t nl = text.find('\n');  // header line
+            if (nl == std::string_view::npos) return false;
+            text.remove_prefix(nl + 1);
+            nl = text.find('\n');
+            std::string_view row = text.substr(0, nl);
+            text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+            if (row.substr(0, line.prefix.size()) != line.prefix) return false;
+
+            if (out.values.size() < column + line.columns) out.values.resize(column + line.columns);
+            const char* p = row.data() + line.prefix.size();
+            const char* end = row.data() + row.size();
+            for (size_t i = 0; i < line.columns; ++i) {
+                while (p < end && *p == ' ') ++p;
+                auto res = std::from_chars(p, end, out.values[column + i]);
+                if (res.ec != std::errc()) return false;
+                p = res.ptr;
+            }
+            while (p < end && *p == ' ') ++p;
+            if (p != end) return false;  // more values than header columns
+            column += line.columns;
+        }
+        return true;
+    }
+
+    void build_map() {
+        columns_.clear();
+        for (File& file : files_) {
+            file.lines.clear();
+            std::string_view text = read_file(file.fd);
+            while (!text.empty()) {
+                size_t nl = text.find('\n');
+                std::string_view header = text.substr(0, nl);
+                text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+                nl = text.find('\n');
+                text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+
+                size_t colon = header.find(':');
+                if (colon == std::string_view::npos) continue;
+                std::string_view proto = header.substr(0, colon);
+                Line line{std::string(header.substr(0, colon + 1)), 0};
+                std::string_view fields = header.substr(colon + 1);
+                while (!fields.empty()) {
+                    size_t start = fields.find_first_not_of(' ');
+                    if (start == std::string_view::npos) break;
+                    fields.remove_prefix(start);
+                    size_t stop = std::min(fields.find(' '), fields.size());
+                    std::string_view field = fields.substr(0, stop);
+                    fields.remove_prefix(stop);
+                    columns_.push_back({net_snmp_metric_name(proto, field), kind_of(proto, field)});
+                    line.columns++;
+                }
+                file.lines.push_back(std::move(line));
+            }
+        }
+        layout_++;
+    }
+
+    // Everything is a counter except the current connection count and a few static settings
+    static Kind kind_of(std::string_view proto, std::string_view field) {
+        if (proto == "Tcp" && field == "CurrEstab") return Kind::gauge;
+        if (proto == "Ip" && (field == "Forwarding" || field == "DefaultTTL")) return Kind::config;
+        if (proto == "Tcp" && (field == "RtoAlgorithm" || field == "RtoMin" || field == "RtoMax" || field == "MaxConn")) {
+            return Kind::config;
+        }
+        return Kind::counter;
+    }
+
+    std::vector<File> files_;
+    std::vector<char> buf_;
+    std::vector<Column> columns_;
+    uint64_t layout_ = 0;
+};
+
+// Counters become "<proto>_<field>_per_sec"; gauges keep their plain name; settings are left out.
+inline Reading net_snmp_reading(const std::vector<NetSnmpReader::Column>& columns, const NetSnmpSample& prev,
+                                const NetSnmpSample& cur) {
+    Reading reading;
+    reading.sensor_id = "net_stack";
+    reading.timestamp = timestamp();
+    double seconds = std::chrono::duration<double>(cur.taken - prev.taken).count();
+    reading.values.reserve(columns.size());
+    for (size_t i = 0; i < columns.size() && i < cur.values.size(); ++i) {
+        if (columns[i].kind == NetSnmpReader::Kind::config) continue;
+        if (columns[i].kind == NetSnmpReader::Kind::gauge) {
+            reading.values.emplace_back(columns[i].name, static_cast<double>(cur.values[i]));
+            continue;
+        }
+        // Counters are unsigned long in the kernel; a value that went down was reset, not negative
+        int64_t delta = cur.values[i] >= prev.values[i] ? cur.values[i] - prev.values[i] : 0;
+        reading.values.emplace_back(columns[i].name + "_per_sec", seconds > 0 ? delta / seconds : 0.0);
+    }
+    return reading;
+}
+
+// COUNTER_MODE=raw: counters as "<proto>_<field>_total" for the processor to rate, gauges as above.
+inline Reading net_snmp_counters_reading(const std::vector<NetSnmpReader::Column>& columns, const NetSnmpSample& cur,
+                                         double sampled_at) {
+    Reading reading;
+    reading.sensor_id = "net_stack";
+    reading.timestamp = timestamp();
+    reading.values.reserve(columns.size() + 1);
+    for (size_t i = 0; i < columns.size() && i < cur.values.size(); ++i) {
+        if (columns[i].kind == NetSnmpReader::Kind::config) continue;
+        bool counter = columns[i].kind == NetSnmpReader::Kind::counter;
+        reading.values.emplace_back(counter ? columns[i].name + "_total" : columns[i].name, static_cast<double>(cur.values[i]));
+    }
+    reading.values.emplace_back("sampled_at", sampled_at);
+    return reading;
+}
+
+inline void net_snmp_thread(const std::atomic<bool>& running, ReadingQueue& out, std::chrono::milliseconds interval,
+                            bool raw_counters) {
+    std::cout << "[INFO] Network stack sensor thread started." << std::endl;
+    NetSnmpReader reader;
+    NetSnmpSample prev, cur;
+    bool primed = reader.read(prev) || reader.read(prev);  // the first read only builds the map
+    if (!primed) {
+        std::cerr << "[ERROR] Cannot read /proc/net/snmp; network stack sensor disabled" << std::endl;
+        return;
+    }
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        next += interval;
+        std::this_thread::sleep_until(next);
+        if (!reader.read(cur)) {
+            primed = false;  // layout changed: the next good read only re-primes
+            continue;
+        }
+        if (raw_counters) {
+            out.push(net_snmp_counters_reading(reader.columns(), cur, sampled_at_now()));
+            continue;
+        }
+        if (primed && cur.layout == prev.layout) out.push(net_snmp_reading(reader.columns(), prev, cur));
+        primed = true;
+        std::swap(prev, cur);
+    }
+    std::cout << "[INFO] Network stack sensor thread exiting." << std::endl;
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+// Configurable chain of stages between the sampling side and the sinks.
+//
+//   source (comm_thread) -> stage -> stage -> ... -> sinks (encode + write, one thread each)
+//
+// PIPELINE lists the stages in order. Stages joined with '+' are fused: they
+// run back to back on the same thread with no hand-off. A '>' starts a new
+// segment on its own thread, fed through a bounded lock-free SPSC ring; when a
+// ring is full the reading is dropped and counted, so a slow segment cannot
+// stall the ones before it. The first segment runs on the source thread. An
+// idle segment thread sleeps on a condition variable until its ring gets
+// readings or one of its stages is due (an aggregate window closing).
+//
+// Encoders and sinks are not stages: SINKS configures them (sinks.hpp) and the
+// last segment hands every reading to all of them.
+//
+//   PIPELINE="filter:exclude=statsd.*:consistent + aggregate:10000:max"
+//   PIPELINE="filter:include=cpu_*,disk_* > aggregate:5000"
+//
+// Stages:
+//   filter:include=glob,..   keep only sensor ids matching one of the globs
+//   filter:exclude=glob,..   drop sensor ids matching one of the globs
+//   filter:consistent        drop readings flagged data_consistent=false
+//   aggregate:window_ms[:mean|min|max|last]
+//                            one reading per sensor id and window, each value reduced
+//
+// DERIVED metrics (derived.hpp) run as a stage ahead of these.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fnmatch.h>
+#include "wire.hpp"
+
+// Bounded single-producer/single-consumer ring. Capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    bool push(T&& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) return false;
+        }
+        slots_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves up to max items into out; returns how many were moved.
+    size_t pop(std::vector<T>& out, size_t max) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t available = tail_.load(std::memory_order_acquire) - head;
+        size_t n = std::min(available, max);
+        for (size_t i = 0; i < n; ++i) out.push_back(std::move(slots_[(head + i) & mask_]));
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};  // consumer side
+    alignas(64) std::atomic<size_t> tail_{0};  // producer side
+    size_t head_cache_ = 0;                     // producer's last view of head_
+};
+
+struct Stage {
+    virtual ~Stage() = default;
+    // Transforms the batch in place: may drop, rewrite or hold readings back.
+    virtual void process(std::vector<Reading>& batch) = 0;
+    // Called on every pass, even without input; appends readings that became due.
+    virtual void tick(std::chrono::steady_clock::time_point, std::vector<Reading>&) {}
+    // When tick next has something to do; an idle segment sleeps until then.
+    virtual std::chrono::steady_clock::time_point due() const { return std::chrono::steady_clock::time_point::max(); }
+
+    std::string name;
+    std::atomic<uint64_t> readings_in{0};
+    std::atomic<uint64_t> readings_out{0};
+};
+
+struct FilterStage : Stage {
+    static bool matches_any(const std::vector<std::string>& globs, const std::string& id) {
+        for (const auto& glob : globs) {
+            if (fnmatch(glob.c_str(), id.c_str(), 0) == 0) return true;
+        }
+        return false;
+    }
+
+    void process(std::vector<Reading>& batch) override {
+        batch.erase(std::remove_if(batch.begin(), batch.end(), [&](const Reading& r) {
+            return (!include.empty() && !matches_any(include, r.sensor_id)) ||
+                   matches_any(exclude, r.sensor_id) || (consistent_only && !r.data_consistent);
+        }), batch.end());
+    }
+
+    std::vector<std::string> include;
+    std::vector<std::string> exclude;
+    bool consistent_only = false;
+};
+
+struct AggregateStage : Stage {
+    enum class Reduce { mean, min, max, last };
+
+    struct Acc {
+        double sum = 0, min = 0, max = 0, last = 0;
+        uint64_t n = 0;
+    };
+
+    struct Window {
+        std::vector<std::pair<std::string, Acc>> values;  // first-seen order
+        bool consistent = true;
+    };
+
+    void process(std::vector<Reading>& batch) override {
+        for (auto& reading : batch) {
+            Window& w = windows[reading.sensor_id];
+            w.consistent = w.consistent && reading.data_consistent;
+            for (const auto& [key, value] : reading.values) {
+                auto it = std::find_if(w.values.begin(), w.values.end(), [&](const auto& kv) { return kv.first == key; });
+                if (it == w.values.end()) {
+                    w.values.emplace_back(key, Acc{});
+                    it = w.values.end() - 1;
+                }
+                Acc& acc = it->second;
+                acc.min = acc.n == 0 ? value : std::min(acc.min, value);
+                acc.max = acc.n == 0 ? value : std::max(acc.max, value);
+                acc.sum += value;
+                acc.last = value;
+                acc.n++;
+            }
+        }
+        batch.clear();
+    }
+
+    void tick(std::chrono::steady_clock::time_point now, std::vector<Reading>& out) override {
+        if (next_flush.time_since_epoch().count() == 0) next_flush = now + window;
+        if (now < next_flush) return;
+        next_flush += window;
+        if (next_flush <= now) next_flush = now + window;  // fell behind: skip missed windows
+        std::string ts = timestamp();
+        for (auto& [sensor_id, w] : windows) {
+            Reading reading;
+            reading.sensor_id = sensor_id;
+            reading.timestamp = ts;
+            reading.data_consistent = w.consistent;
+            for (const auto& [key, acc] : w.values) {
+                double v = reduce == Reduce::mean ? acc.sum / acc.n
+                         : reduce == Reduce::min  ? acc.min
+                         : reduce == Reduce::max  ? acc.max
+                         : acc.last;
+                reading.values.emplace_back(key, v);
+            }
+            out.push_back(std::move(reading));
+        }
+        windows.clear();
+    }
+
+    std::chrono::steady_clock::time_point due() const override { return next_flush; }
+
+    std::chrono::milliseconds window{10000};
+    Reduce reduce = Reduce::mean;
+    std::chrono::steady_clock::time_point next_flush{};
+    std::unordered_map<std::string, Window> windows;
+};
+
+inline std::vector<std::string> split_spec(const std::string& s, char sep) {
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(sep, pos);
+        if (end == std::string::npos) end = s.size();
+        parts.push_back(s.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return parts;
+}
+
+inline std::string trim_spec(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t");
+    size_t e = s.find_last_not_of(" \t");
+    return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+// Builds a stage from "name:arg:arg"; nullptr (with an error logged) if the spec is invalid.
+inline std::unique_ptr<Stage> make_stage(const std::string& spec) {
+    std::vector<std::string> args = split_spec(spec, ':');
+    const std::string kind = args[0];
+    std::unique_ptr<Stage> stage;
+    if (kind == "filter") {
+        auto filter = std::make_unique<FilterStage>();
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (args[i].rfind("include=", 0) == 0) filter->include = split_spec(args[i].substr(8), ',');
+            else if (args[i].rfind("exclude=", 0) == 0) filter->exclude = split_spec(args[i].substr(8), ',');
+            else if (args[i] == "consistent") filter->consistent_only = true;
+            else filter.reset();
+            if (!filter) break;
+        }
+        stage = std::move(filter);
+    } else if (kind == "aggregate" && args.size() >= 2) {
+        auto agg = std::make_unique<AggregateStage>();
+        char* end = nullptr;
+        long ms = std::strtol(args[1].c_str(), &end, 10);
+        if (ms > 0 && *end == '\0') agg->window = std::chrono::milliseconds(ms);
+        else agg.reset();
+        if (agg && args.size() >= 3) {
+            if (args[2] == "mean") agg->reduce = AggregateStage::Reduce::mean;
+            else if (args[2] == "min") agg->reduce = AggregateStage::Reduce::min;
+            else if (args[2] == "max") agg->reduce = AggregateStage::Reduce::max;
+            else if (args[2] == "last") agg->reduce = AggregateStage::Reduce::last;
+            else agg.reset();
+        }
+        stage = std::move(agg);
+    }
+    if (!stage) {
+        std::cerr << "[ERROR] Invalid pipeline stage '" << spec << "'" << std::endl;
+        return nullptr;
+    }
+    stage->name = kind;
+    return stage;
+}
+
+class Pipeline {
+public:
+    using Terminal = std::function<void(std::vector<Reading>&)>;
+
+    // Parses PIPELINE; false if any stage is invalid, or if the spec needs rings
+    // ('>') and ring_capacity is 0. An empty spec means no stages.
+    bool configure(const std::string& spec, size_t ring_capacity) {
+        segments_.clear();
+        segments_.push_back(std::make_unique<Segment>(0));
+        if (trim_spec(spec).empty()) return true;
+        if (ring_capacity == 0 && spec.find('>') != std::string::npos) {
+            std::cerr << "[ERROR] PIPELINE_QUEUE must be at least 1 when PIPELINE has '>' segments" << std::endl;
+            return false;
+        }
+        size_t pos = 0;
+        while (pos <= spec.size()) {
+            size_t end = spec.find_first_of(">+", pos);
+            if (end == std::string::npos) end = spec.size();
+            auto stage = make_stage(trim_spec(spec.substr(pos, end - pos)));
+            if (!stage) return false;
+            segments_.back()->stages.push_back(std::move(stage));
+            if (end < spec.size() && spec[end] == '>') segments_.push_back(std::make_unique<Segment>(ring_capacity));
+            pos = end + 1;
+        }
+        return true;
+    }
+
+    // Puts a stage ahead of the configured ones, on the source thread.
+    void prepend(std::unique_ptr<Stage> stage) {
+        auto& stages = segments_.front()->stages;
+        stages.insert(stages.begin(), std::move(stage));
+    }
+
+    // Segments after the first get their own threads; the last one hands readings to terminal.
+    void start(const std::atomic<bool>& running, Terminal terminal) {
+        terminal_ = std::move(terminal);
+        for (size_t i = 1; i < segments_.size(); ++i) {
+            segments_[i]->thread = std::thread(&Pipeline::segment_loop, this, i, std::cref(running));
+        }
+    }
+
+    // After running went false: wakes the segment threads and waits for them.
+    void join() {
+        for (auto& segment : segments_) {
+            std::lock_guard<std::mutex> lock(segment->mu);
+            segment->ready.notify_one();
+        }
+        for (auto& segment : segments_) {
+            if (segment->thread.joinable()) segment->thread.join();
+        }
+    }
+
+    // Called by the source thread: runs the first segment inline and passes the result on.
+    void push(std::vector<Reading>& batch) {
+        run_segment(0, batch, std::chrono::steady_clock::now());
+    }
+
+    std::string describe() const {
+        std::string out = "source";
+        for (size_t i = 0; i < segments_.size(); ++i) {
+            for (size_t j = 0; j < segments_[i]->stages.size(); ++j) {
+                out += i > 0 && j == 0 ? " > " : " + ";
+                out += segments_[i]->stages[j]->name;
+            }
+        }
+        return out + " > sinks";
+    }
+
+    // "pipeline": readings in and out of every stage, drops and depth of every ring.
+    Reading stats_reading() const {
+        Reading reading;
+        reading.sensor_id = "pipeline";
+        reading.timestamp = timestamp();
+        int n = 0;
+        for (size_t i = 0; i < segments_.size(); ++i) {
+            const Segment& segment = *segments_[i];
+            if (segment.ring) {
+                std::string hop = "hop" + std::to_string(i);
+                reading.values.emplace_back(hop + "_dropped_total", static_cast<double>(segment.dropped.load()));
+                reading.values.emplace_back(hop + "_depth", static_cast<double>(segment.ring->size()));
+            }
+            for (const auto& stage : segment.stages) {
+                std::string prefix = "stage" + std::to_string(++n) + "_" + stage->name;
+                reading.values.emplace_back(prefix + "_in_total", static_cast<double>(stage->readings_in.load()));
+                reading.values.emplace_back(prefix + "_out_total", static_cast<double>(stage->readings_out.load()));
+            }
+        }
+        return reading;
+    }
+
+private:
+    struct Segment {
+        explicit Segment(size_t ring_capacity) {
+            if (ring_capacity > 0) ring = std::make_unique<SpscRing<Reading>>(ring_capacity);
+        }
+        std::vector<std::unique_ptr<Stage>> stages;
+        std::unique_ptr<SpscRing<Reading>> ring;  // input; none for the first segment
+        std::atomic<uint64_t> dropped{0};
+        std::thread thread;
+        // Wake-up for an empty ring; the producer only takes mu when the consumer is asleep
+        std::mutex mu;
+        std::condition_variable ready;
+        std::atomic<bool> sleeping{false};
+    };
+
+    void run_segment(size_t index, std::vector<Reading>& batch, std::chrono::steady_clock::time_point now) {
+        for (auto& stage : segments_[index]->stages) {
+            stage->readings_in += batch.size();
+            stage->process(batch);
+            stage->tick(now, batch);
+            stage->readings_out += batch.size();
+        }
+        if (batch.empty()) return;
+        if (index + 1 == segments_.size()) {
+            terminal_(batch);
+            return;
+        }
+        Segment& next = *segments_[index + 1];
+        for (auto& reading : batch) {
+            if (!next.ring->push(std::move(reading))) next.dropped++;
+        }
+        batch.clear();
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with the consumer's fence in segment_loop
+        if (next.sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(next.mu);
+            next.ready.notify_one();
+        }
+    }
+
+    void segment_loop(size_t index, const std::atomic<bool>& running) {
+        Segment& segment = *segments_[index];
+        std::vector<Reading> batch;
+        while (running) {
+            batch.clear();
+            size_t n = segment.ring->pop(batch, 1024);
+            run_segment(index, batch, std::chrono::steady_clock::now());
+            if (n > 0) continue;
+            auto due = std::chrono::steady_clock::time_point::max();
+            for (const auto& stage : segment.stages) due = std::min(due, stage->due());
+            std::unique_lock<std::mutex> lock(segment.mu);
+            segment.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);  // the producer sees sleeping or we see its readings
+            auto woken = [&] { return segment.ring->size() > 0 || !running; };
+            if (due == std::chrono::steady_clock::time_point::max()) segment.ready.wait(lock, woken);
+            else segment.ready.wait_until(lock, due, woken);
+            segment.sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<std::unique_ptr<Segment>> segments_;
+    Terminal terminal_;
+};
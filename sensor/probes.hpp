@@ -0,0 +1,526 @@
+#pragma once
+
+// Synthetic checks against local services: TCP connects and HTTP GETs, all
+// driven from one epoll loop so thousands of targets cost one thread. Every
+// PROBE_MS each target is probed once. Connects are non-blocking; an HTTP
+// probe then sends its request and waits for the status line. Per-probe
+// deadlines are kept in start order, so expiring them is a walk from the
+// oldest pending probe rather than a scan.
+//
+// Numeric addresses are taken as they are. Host names are looked up on a
+// resolver thread of its own, since getaddrinfo blocks for as long as DNS
+// takes; a round probes with the address it has (a name not yet resolved
+// counts as an error) and looks again every kResolveTtl, or sooner after
+// kReresolveAfter failed probes in a row, in case the service has moved.
+//
+// PROBES lists targets, comma-separated, each optionally named:
+//   "tcp:127.0.0.1:5432", "api=http://127.0.0.1:8080/healthz"
+// Each target gets a "probe_<name>" reading (up, last latency, p50/p99 and
+// success ratio over its last kWindow runs). A "probes" reading summarises the
+// round: counts by outcome and latency quantiles from a log2 histogram.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+enum class ProbeOutcome { ok, refused, timed_out, bad_status, error };
+
+struct ProbeTarget {
+    static constexpr size_t kWindow = 60;
+
+    std::string name;
+    bool http = false;
+    std::string host;  // for the Host header
+    std::string path;
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    bool resolved = false;
+    bool literal = false;    // a numeric address: never looked up again
+    bool resolving = false;  // a lookup is queued on the resolver thread
+    std::chrono::steady_clock::time_point resolved_at;
+    uint32_t failures = 0;   // probes in a row that did not reach the service
+    std::string port;
+
+    // Results of the last kWindow runs
+    std::deque<double> latencies_ms;  // successful runs only
+    std::deque<bool> results;
+    ProbeOutcome last = ProbeOutcome::error;
+    double last_ms = 0;
+    int last_status = 0;
+
+    void record(ProbeOutcome outcome, double ms, int status) {
+        last = outcome;
+        last_ms = ms;
+        last_status = status;
+        failures = outcome == ProbeOutcome::ok || outcome == ProbeOutcome::bad_status ? 0 : failures + 1;
+        results.push_back(outcome == ProbeOutcome::ok);
+        if (results.size() > kWindow) results.pop_front();
+        if (outcome == ProbeOutcome::ok) {
+            latencies_ms.push_back(ms);
+            if (latencies_ms.size() > kWindow) latencies_ms.pop_front();
+        }
+    }
+};
+
+// "name=tcp:host:port" / "name=http://host:port/path"; false if the entry is not understood.
+inline bool parse_probe_target(const std::string& entry, ProbeTarget& out) {
+    std::string spec = entry;
+    size_t eq = spec.find('=');
+    size_t scheme = spec.find(':');
+    if (eq != std::string::npos && eq < scheme) {
+        out.name = spec.substr(0, eq);
+        spec = spec.substr(eq + 1);
+    }
+    std::string hostport;
+    if (spec.rfind("tcp:", 0) == 0) {
+        hostport = spec.substr(4);
+    } else if (spec.rfind("http://", 0) == 0) {
+        out.http = true;
+        size_t slash = spec.find('/', 7);
+        hostport = spec.substr(7, slash == std::string::npos ? std::string::npos : slash - 7);
+        out.path = slash == std::string::npos ? "/" : spec.substr(slash);
+    } else {
+        return false;
+    }
+    size_t colon = hostport.rfind(':');
+    if (colon == std::string::npos) {
+        if (!out.http) return false;
+        out.host = hostport;
+        out.port = "80";
+    } else {
+        out.host = hostport.substr(0, colon);
+        out.port = hostport.substr(colon + 1);
+    }
+    if (out.host.size() > 2 && out.host.front() == '[' && out.host.back() == ']') out.host = out.host.substr(1, out.host.size() - 2);
+    if (out.name.empty()) {
+        out.name = (out.http ? "http_" : "tcp_") + out.host + "_" + out.port;
+        for (char& c : out.name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') c = '_';
+        }
+    }
+    return !out.host.empty() && !out.port.empty();
+}
+
+// getaddrinfo into addr; with AI_NUMERICHOST in flags it never touches DNS and so never blocks.
+inline bool resolve_probe_address(const std::string& host, const std::string& port, int flags,
+                                  sockaddr_storage& addr, socklen_t& addr_len) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = flags;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result) return false;
+    std::memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+// Host name lookups off the probe thread. The worker is detached and shares its
+// state, so a lookup stuck in the resolver at shutdown does not hold the agent up.
+class ProbeResolver {
+public:
+    struct Result {
+        size_t target;
+        bool ok = false;
+        sockaddr_storage addr{};
+        socklen_t addr_len = 0;
+    };
+
+    ProbeResolver() : state_(std::make_shared<State>()) {}
+    ~ProbeResolver() {
+        {
+            std::lock_guard<std::mutex> lock(state_->mu);
+            state_->stopping = true;
+        }
+        state_->wake.notify_one();
+    }
+    ProbeResolver(const ProbeResolver&) = delete;
+    ProbeResolver& operator=(const ProbeResolver&) = delete;
+
+    void request(size_t target, const std::string& host, const std::string& port) {
+        if (!started_) {
+            std::thread(work, state_).detach();  // only once there is a name to look up
+            started_ = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_->mu);
+            state_->pending.push_back({target, host, port});
+        }
+        state_->wake.notify_one();
+    }
+
+    // Moves the lookups finished since the last call into out.
+    void collect(std::vector<Result>& out) {
+        std::lock_guard<std::mutex> lock(state_->mu);
+        out.swap(state_->done);
+    }
+
+private:
+    struct Request {
+        size_t target;
+        std::string host, port;
+    };
+    struct State {
+        std::mutex mu;
+        std::condition_variable wake;
+        std::deque<Request> pending;
+        std::vector<Result> done;
+        bool stopping = false;
+    };
+
+    static void work(std::shared_ptr<State> state) {
+        std::unique_lock<std::mutex> lock(state->mu);
+        while (true) {
+            state->wake.wait(lock, [&] { return state->stopping || !state->pending.empty(); });
+            if (state->stopping) return;
+            Request request = std::move(state->pending.front());
+            state->pending.pop_front();
+            lock.unlock();
+            Result result;
+            result.target = request.target;
+            result.ok = resolve_probe_address(request.host, request.port, 0, result.addr, result.addr_len);
+            lock.lock();
+            state->done.push_back(result);
+        }
+    }
+
+    std::shared_ptr<State> state_;
+    bool started_ = false;
+};
+
+// Latency histogram for one round: bucket b holds [2^b, 2^(b+1)) microseconds.
+struct ProbeHistogram {
+    std::array<uint32_t, 32> buckets{};
+    uint64_t count = 0;
+    double max_ms = 0;
+
+    void add(double ms) {
+        uint64_t us = static_cast<uint64_t>(ms * 1000.0);
+        buckets[us == 0 ? 0 : std::min(31, 63 - __builtin_clzll(us))]++;
+        count++;
+        max_ms = std::max(max_ms, ms);
+    }
+
+    double quantile_ms(double q) const {
+        uint64_t rank = static_cast<uint64_t>(q * count);
+        uint64_t seen = 0;
+        for (int b = 0; b < 32; ++b) {
+            seen += buckets[b];
+            if (seen > rank) return std::min(static_cast<double>(2ull << b) / 1000.0, max_ms);
+        }
+        return max_ms;
+    }
+};
+
+class ProbeRunner {
+public:
+    ProbeRunner(std::vector<ProbeTarget> targets, std::chrono::milliseconds timeout, size_t concurrency)
+        : targets_(std::move(targets)), timeout_(timeout), concurrency_(std::max<size_t>(1, concurrency)),
+          epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {
+        for (auto& target : targets_) {
+            target.literal = resolve_probe_address(target.host, target.port, AI_NUMERICHOST, target.addr, target.addr_len);
+            target.resolved = target.literal;
+        }
+        refresh_addresses();
+    }
+    ~ProbeRunner() { if (epoll_fd_ >= 0) close(epoll_fd_); }
+    ProbeRunner(const ProbeRunner&) = delete;
+    ProbeRunner& operator=(const ProbeRunner&) = delete;
+
+    bool ok() const { return epoll_fd_ >= 0; }
+    const std::vector<ProbeTarget>& targets() const { return targets_; }
+
+    // Probes every target once, at most concurrency at a time; returns the round's histogram.
+    ProbeHistogram run_round(uint64_t counts[5]) {
+        refresh_addresses();
+        ProbeHistogram histogram;
+        std::fill(counts, counts + 5, 0);
+        inflight_.clear();
+        size_t next = 0;      // next target to start
+        size_t oldest = 0;    // first inflight slot that may still be pending (deadlines are in start order)
+        size_t active = 0;
+        std::vector<epoll_event> events(256);
+
+        auto finish = [&](Inflight& probe, ProbeOutcome outcome, int status) {
+            if (probe.fd >= 0) {
+                close(probe.fd);  // also drops it from the epoll set
+                probe.fd = -1;
+            }
+            probe.done = true;
+            active--;
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - probe.started).count();
+            ProbeTarget& target = targets_[probe.target];
+            target.record(outcome, ms, status);
+            counts[static_cast<int>(outcome)]++;
+            if (outcome == ProbeOutcome::ok) histogram.add(ms);
+        };
+
+        while (next < targets_.size() || active > 0) {
+            while (active < concurrency_ && next < targets_.size()) {
+                start(next++);
+                if (inflight_.back().done) counts[static_cast<int>(targets_[next - 1].last)]++;  // failed before connecting
+                else active++;
+            }
+            // Expire from the oldest; everything after the first live, unexpired probe started later
+            auto now = Clock::now();
+            for (; oldest < inflight_.size(); ++oldest) {
+                Inflight& probe = inflight_[oldest];
+                if (probe.done) continue;
+                if (now < probe.deadline) break;
+                finish(probe, ProbeOutcome::timed_out, 0);
+            }
+            if (active == 0) continue;
+            int wait_ms = 0;
+            if (oldest < inflight_.size()) {
+                wait_ms = static_cast<int>(std::max<long long>(
+                    1, std::chrono::duration_cast<std::chrono::milliseconds>(inflight_[oldest].deadline - now).count()));
+            }
+            int n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), wait_ms);
+            for (int i = 0; i < n; ++i) {
+                Inflight& probe = inflight_[events[i].data.u64];
+                if (probe.done) continue;
+                advance(probe, finish);
+            }
+        }
+        return histogram;
+    }
+
+    static constexpr std::chrono::minutes kResolveTtl{5};
+    static constexpr uint32_t kReresolveAfter = 3;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Takes in finished lookups and queues the names that are unresolved, past
+    // kResolveTtl or failing; a known address stays in use until a lookup replaces it.
+    void refresh_addresses() {
+        auto now = Clock::now();
+        resolver_.collect(lookups_);
+        for (const auto& lookup : lookups_) {
+            ProbeTarget& target = targets_[lookup.target];
+            target.resolving = false;
+            target.resolved_at = now;
+            target.failures = 0;
+            if (!lookup.ok) continue;
+            target.addr = lookup.addr;
+            target.addr_len = lookup.addr_len;
+            target.resolved = true;
+        }
+        lookups_.clear();
+        for (size_t i = 0; i < targets_.size(); ++i) {
+            ProbeTarget& target = targets_[i];
+            if (target.literal || target.resolving) continue;
+            if (target.resolved && now - target.resolved_at < kResolveTtl && target.failures < kReresolveAfter) continue;
+            target.resolving = true;
+            resolver_.request(i, target.host, target.port);
+        }
+    }
+
+    struct Inflight {
+        size_t target;
+        int fd = -1;
+        Clock::time_point started;
+        Clock::time_point deadline;
+        bool connected = false;
+        bool done = false;
+        std::string response;  // status line so far
+    };
+
+    void start(size_t index) {
+        ProbeTarget& target = targets_[index];
+        Inflight started;
+        started.target = index;
+        inflight_.push_back(std::move(started));
+        Inflight& probe = inflight_.back();
+        probe.started = Clock::now();
+        probe.deadline = probe.started + timeout_;
+        if (!target.resolved) {
+            probe.done = true;
+            target.record(ProbeOutcome::error, 0, 0);
+            return;
+        }
+        probe.fd = socket(target.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (probe.fd < 0) {
+            probe.done = true;
+            target.record(ProbeOutcome::error, 0, 0);
+            return;
+        }
+        int one = 1;
+        setsockopt(probe.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int rc = connect(probe.fd, reinterpret_cast<const sockaddr*>(&target.addr), target.addr_len);
+        if (rc < 0 && errno != EINPROGRESS) {
+            close(probe.fd);
+            probe.fd = -1;
+            probe.done = true;
+            target.record(errno == ECONNREFUSED ? ProbeOutcome::refused : ProbeOutcome::error, 0, 0);
+            return;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLOUT;
+        ev.data.u64 = inflight_.size() - 1;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, probe.fd, &ev);
+    }
+
+    template <typename Finish>
+    void advance(Inflight& probe, Finish& finish) {
+        ProbeTarget& target = targets_[probe.target];
+        if (!probe.connected) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(probe.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                finish(probe, err == ECONNREFUSED ? ProbeOutcome::refused : ProbeOutcome::error, 0);
+                return;
+            }
+            probe.connected = true;
+            if (!target.http) {
+                finish(probe, ProbeOutcome::ok, 0);
+                return;
+            }
+            std::string request = "GET " + target.path + " HTTP/1.1\r\nHost: " + target.host +
+                                  "\r\nUser-Agent: telemetrylink-probe\r\nConnection: close\r\n\r\n";
+            if (send(probe.fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+                finish(probe, ProbeOutcome::error, 0);
+                return;
+            }
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.u64 = static_cast<uint64_t>(&probe - inflight_.data());
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, probe.fd, &ev);
+            return;
+        }
+        // Latency is time to the status line; the rest of the response is not waited for
+        char buf[512];
+        ssize_t n = recv(probe.fd, buf, sizeof(buf), 0);
+        if (n > 0) probe.response.append(buf, static_cast<size_t>(n));
+        size_t eol = probe.response.find("\r\n");
+        if (eol == std::string::npos) {
+            if (n <= 0 && !(n < 0 && errno == EAGAIN)) finish(probe, ProbeOutcome::error, 0);
+            else if (probe.response.size() > 4096) finish(probe, ProbeOutcome::error, 0);
+            return;
+        }
+        int status = 0;
+        if (probe.response.rfind("HTTP/", 0) == 0) {
+            size_t space = probe.response.find(' ');
+            if (space != std::string::npos) status = std::atoi(probe.response.c_str() + space + 1);
+        }
+        finish(probe, status >= 200 && status < 400 ? ProbeOutcome::ok : ProbeOutcome::bad_status, status);
+    }
+
+    std::vector<ProbeTarget> targets_;
+    std::chrono::milliseconds timeout_;
+    size_t concurrency_;
+    int epoll_fd_;
+    std::vector<Inflight> inflight_;
+    ProbeResolver resolver_;
+    std::vector<ProbeResolver::Result> lookups_;
+};
+
+inline Reading probe_target_reading(const ProbeTarget& target) {
+    Reading reading;
+    reading.sensor_id = "probe_" + target.name;
+    std::vector<double> sorted(target.latencies_ms.begin(), target.latencies_ms.end());
+    std::sort(sorted.begin(), sorted.end());
+    auto quantile = [&](double q) { return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))]; };
+    size_t successes = static_cast<size_t>(std::count(target.results.begin(), target.results.end(), true));
+    reading.values = {
+        {"up", target.last == ProbeOutcome::ok ? 1.0 : 0.0},
+        {"latency_ms", target.last == ProbeOutcome::ok ? target.last_ms : 0.0},
+        {"latency_p50_ms", quantile(0.50)},
+        {"latency_p99_ms", quantile(0.99)},
+        {"success_ratio", target.results.empty() ? 0.0 : static_cast<double>(successes) / target.results.size()},
+        {"timed_out", target.last == ProbeOutcome::timed_out ? 1.0 : 0.0},
+    };
+    if (target.http) reading.values.emplace_back("status", static_cast<double>(target.last_status));
+    return reading;
+}
+
+// Targets from PROBES entries; later duplicates of a name get a numeric suffix.
+inline std::vector<ProbeTarget> parse_probe_targets(const std::vector<std::string>& entries) {
+    std::vector<ProbeTarget> targets;
+    std::map<std::string, int> seen;
+    for (const std::string& entry : entries) {
+        if (entry.empty()) continue;
+        ProbeTarget target;
+        if (!parse_probe_target(entry, target)) {
+            std::cerr << "[WARN] Ignoring probe target '" << entry << "'" << std::endl;
+            continue;
+        }
+        int n = ++seen[target.name];
+        if (n > 1) target.name += "_" + std::to_string(n);
+        targets.push_back(std::move(target));
+    }
+    return targets;
+}
+
+inline void probe_thread(const std::atomic<bool>& running, ReadingQueue& out, std::vector<ProbeTarget> targets,
+                         std::chrono::milliseconds interval, std::chrono::milliseconds timeout, size_t concurrency) {
+    ProbeRunner runner(std::move(targets), timeout, concurrency);
+    if (!runner.ok()) {
+        std::cerr << "[ERROR] Cannot create epoll instance; probes disabled" << std::endl;
+        return;
+    }
+    std::cout << "[INFO] Probe thread started (" << runner.targets().size() << " targets)." << std::endl;
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        auto started = std::chrono::steady_clock::now();
+        uint64_t counts[5];
+        ProbeHistogram histogram = runner.run_round(counts);
+        double round_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+        std::string ts = timestamp();
+        for (const auto& target : runner.targets()) {
+            Reading reading = probe_target_reading(target);
+            reading.timestamp = ts;
+            out.push(std::move(reading));
+        }
+        Reading summary;
+        summary.sensor_id = "probes";
+        summary.timestamp = ts;
+        double total = static_cast<double>(runner.targets().size());
+        summary.values = {
+            {"targets", total},
+            {"ok", static_cast<double>(counts[static_cast<int>(ProbeOutcome::ok)])},
+            {"refused", static_cast<double>(counts[static_cast<int>(ProbeOutcome::refused)])},
+            {"timed_out", static_cast<double>(counts[static_cast<int>(ProbeOutcome::timed_out)])},
+            {"bad_status", static_cast<double>(counts[static_cast<int>(ProbeOutcome::bad_status)])},
+            {"errors", static_cast<double>(counts[static_cast<int>(ProbeOutcome::error)])},
+            {"success_ratio", total > 0 ? counts[static_cast<int>(ProbeOutcome::ok)] / total : 0.0},
+            {"latency_p50_ms", histogram.quantile_ms(0.50)},
+            {"latency_p90_ms", histogram.quantile_ms(0.90)},
+            {"latency_p99_ms", histogram.quantile_ms(0.99)},
+            {"latency_max_ms", histogram.max_ms},
+            {"round_ms", round_ms},
+        };
+        out.push(std::move(summary));
+
+        next += interval;
+        if (next < std::chrono::steady_clock::now()) next = std::chrono::steady_clock::now();  // a round overran
+        std::this_thread::sleep_until(next);
+    }
+    std::cout << "[INFO] Probe thread exiting." << std::endl;
+}
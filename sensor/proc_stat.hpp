@@ -0,0 +1,167 @@
+#pragma once
+
+// Everything /proc/stat has to offer from one pread per tick: the aggregate
+// CPU time split by category, plus context switches, interrupts, softirqs,
+// forks and the running/blocked task counts. The file stays open and is re-read
+// from offset 0, so a tick costs exactly one syscall.
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "wire.hpp"
+
+struct ProcStatSample {
+    enum Cpu { user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice, kCpuFields };
+
+    std::chrono::steady_clock::time_point taken;
+    uint64_t cpu[kCpuFields] = {};  // USER_HZ ticks summed over all CPUs
+    uint64_t context_switches = 0;
+    uint64_t interrupts = 0;
+    uint64_t softirqs = 0;
+    uint64_t forks = 0;
+    uint64_t procs_running = 0;
+    uint64_t procs_blocked = 0;
+    uint32_t cpus = 0;
+};
+
+// Reads the numbers following a "label " prefix into out; returns how many were read.
+inline size_t parse_proc_numbers(std::string_view line, uint64_t* out, size_t max) {
+    size_t count = 0;
+    const char* p = line.data();
+    const char* end = p + line.size();
+    while (count < max) {
+        while (p < end && *p == ' ') ++p;
+        auto res = std::from_chars(p, end, out[count]);
+        if (res.ec != std::errc()) break;
+        p = res.ptr;
+        count++;
+    }
+    return count;
+}
+
+inline void parse_proc_stat(std::string_view text, ProcStatSample& out) {
+    out.cpus = 0;
+    while (!text.empty()) {
+        size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+
+        if (line.substr(0, 4) == "cpu ") {
+            parse_proc_numbers(line.substr(4), out.cpu, ProcStatSample::kCpuFields);
+            continue;
+        }
+        if (line.substr(0, 3) == "cpu") {
+            out.cpus++;
+            continue;
+        }
+        const std::pair<std::string_view, uint64_t*> counters[] = {
+            {"ctxt ", &out.context_switches}, {"intr ", &out.interrupts}, {"softirq ", &out.softirqs},
+            {"processes ", &out.forks}, {"procs_running ", &out.procs_running}, {"procs_blocked ", &out.procs_blocked},
+        };
+        for (const auto& [label, field] : counters) {
+            if (line.substr(0, label.size()) == label) {
+                parse_proc_numbers(line.substr(label.size()), field, 1);  // intr/softirq: the total comes first
+                break;
+            }
+        }
+    }
+}
+
+class ProcStatReader {
+public:
+    explicit ProcStatReader(const char* path = "/proc/stat") : fd_(open(path, O_RDONLY | O_CLOEXEC)), buf_(16384) {}
+    ~ProcStatReader() { if (fd_ >= 0) close(fd_); }
+    ProcStatReader(const ProcStatReader&) = delete;
+    ProcStatReader& operator=(const ProcStatReader&) = delete;
+
+    bool read(ProcStatSample& out) {
+        if (fd_ < 0) return false;
+        ssize_t n;
+        // A full buffer may mean a truncated file (huge intr line on big boxes): grow once and re-read
+        while ((n = pread(fd_, buf_.data(), buf_.size(), 0)) == static_cast<ssize_t>(buf_.size())) {
+            buf_.resize(buf_.size() * 2);
+        }
+        if (n <= 0) return false;
+        out.taken = std::chrono::steady_clock::now();
+        parse_proc_stat(std::string_view(buf_.data(), static_cast<size_t>(n)), out);
+        return true;
+    }
+
+private:
+    int fd_;
+    std::vector<char> buf_;
+};
+
+// Busy share of all CPU time between two samples: everything except idle and iowait.
+inline double cpu_busy_percent(const ProcStatSample& prev, const ProcStatSample& cur) {
+    using S = ProcStatSample;
+    uint64_t total = 0;
+    for (int f = S::user; f <= S::steal; ++f) total += cur.cpu[f] - prev.cpu[f];
+    uint64_t idle = (cur.cpu[S::idle] - prev.cpu[S::idle]) + (cur.cpu[S::iowait] - prev.cpu[S::iowait]);
+    return total > 0 ? static_cast<double>(total - idle) / total * 100.0 : 0.0;
+}
+
+// "proc_stat" reading: per-category CPU percentages (idle is 100 minus the rest),
+// event rates per second and the instantaneous task counts.
+inline Reading proc_stat_reading(const ProcStatSample& prev, const ProcStatSample& cur) {
+    using S = ProcStatSample;
+    Reading reading;
+    reading.sensor_id = "proc_stat";
+    reading.timestamp = timestamp();
+
+    uint64_t total = 0;
+    for (int f = S::user; f <= S::steal; ++f) total += cur.cpu[f] - prev.cpu[f];
+    auto share = [&](uint64_t ticks) { return total > 0 ? static_cast<double>(ticks) / total * 100.0 : 0.0; };
+    auto delta = [](uint64_t a, uint64_t b) { return b >= a ? b - a : 0; };  // counters never go back; guard anyway
+    static const std::pair<const char*, int> categories[] = {
+        {"cpu_user_percent", S::user}, {"cpu_nice_percent", S::nice}, {"cpu_system_percent", S::system},
+        {"cpu_iowait_percent", S::iowait}, {"cpu_irq_percent", S::irq}, {"cpu_softirq_percent", S::softirq},
+        {"cpu_steal_percent", S::steal},
+    };
+    for (const auto& [name, field] : categories) {
+        reading.values.emplace_back(name, share(delta(prev.cpu[field], cur.cpu[field])));
+    }
+    // guest time is already counted in user/nice; reported for visibility only
+    reading.values.emplace_back("cpu_guest_percent", share(delta(prev.cpu[S::guest], cur.cpu[S::guest]) +
+                                                           delta(prev.cpu[S::guest_nice], cur.cpu[S::guest_nice])));
+
+    double seconds = std::chrono::duration<double>(cur.taken - prev.taken).count();
+    auto rate = [&](uint64_t a, uint64_t b) { return seconds > 0 ? delta(a, b) / seconds : 0.0; };
+    reading.values.emplace_back("context_switches_per_sec", rate(prev.context_switches, cur.context_switches));
+    reading.values.emplace_back("interrupts_per_sec", rate(prev.interrupts, cur.interrupts));
+    reading.values.emplace_back("softirqs_per_sec", rate(prev.softirqs, cur.softirqs));
+    reading.values.emplace_back("forks_per_sec", rate(prev.forks, cur.forks));
+    reading.values.emplace_back("procs_running", static_cast<double>(cur.procs_running));
+    reading.values.emplace_back("procs_blocked", static_cast<double>(cur.procs_blocked));
+    reading.values.emplace_back("cpus", static_cast<double>(cur.cpus));
+    return reading;
+}
+
+// COUNTER_MODE=raw: the cumulative counters themselves, for the processor to turn into
+// rates. Guest time is left out as it is already part of user and nice.
+inline Reading proc_stat_counters_reading(const ProcStatSample& cur, double sampled_at) {
+    using S = ProcStatSample;
+    Reading reading;
+    reading.sensor_id = "proc_stat";
+    reading.timestamp = timestamp();
+    static const std::pair<const char*, int> categories[] = {
+        {"cpu_user_jiffies_total", S::user}, {"cpu_nice_jiffies_total", S::nice},
+        {"cpu_system_jiffies_total", S::system}, {"cpu_idle_jiffies_total", S::idle},
+        {"cpu_iowait_jiffies_total", S::iowait}, {"cpu_irq_jiffies_total", S::irq},
+        {"cpu_softirq_jiffies_total", S::softirq}, {"cpu_steal_jiffies_total", S::steal},
+    };
+    for (const auto& [name, field] : categories) reading.values.emplace_back(name, static_cast<double>(cur.cpu[field]));
+    reading.values.emplace_back("context_switches_total", static_cast<double>(cur.context_switches));
+    reading.values.emplace_back("interrupts_total", static_cast<double>(cur.interrupts));
+    reading.values.emplace_back("softirqs_total", static_cast<double>(cur.softirqs));
+    reading.values.emplace_back("forks_total", static_cast<double>(cur.forks));
+    reading.values.emplace_back("procs_running", static_cast<double>(cur.procs_running));
+    reading.values.emplace_back("procs_blocked", static_cast<double>(cur.procs_blocked));
+    reading.values.emplace_back("cpus", static_cast<double>(cur.cpus));
+    reading.values.emplace_back("sampled_at", sampled_at);
+    return reading;
+}
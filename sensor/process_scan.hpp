@@ -0,0 +1,139 @@
+#pragma once
+
+// Per-process scan: reads /proc/<pid>/stat for every process and folds the
+// results into one "processes" reading (counts by state, threads, resident
+// memory). The pid list is cut into ranges that run as separate tasks on the
+// TaskPool; each task fills its own totals and they are merged at the end of
+// the tick, so no task ever touches shared state.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "task_pool.hpp"
+#include "wire.hpp"
+
+struct ProcessTotals {
+    uint64_t processes = 0;
+    uint64_t threads = 0;
+    uint64_t running = 0;
+    uint64_t sleeping = 0;
+    uint64_t blocked = 0;   // uninterruptible sleep (D)
+    uint64_t zombie = 0;
+    uint64_t rss_pages = 0;
+
+    void merge(const ProcessTotals& other) {
+        processes += other.processes;
+        threads += other.threads;
+        running += other.running;
+        sleeping += other.sleeping;
+        blocked += other.blocked;
+        zombie += other.zombie;
+        rss_pages += other.rss_pages;
+    }
+};
+
+inline std::vector<int> list_pids(const char* proc = "/proc") {
+    std::vector<int> pids;
+    DIR* dir = opendir(proc);
+    if (!dir) return pids;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9') pids.push_back(std::atoi(entry->d_name));
+    }
+    closedir(dir);
+    return pids;
+}
+
+// Adds one process to totals; a process that exited since listing is simply skipped.
+inline void scan_process(int pid, ProcessTotals& totals, const char* proc = "/proc") {
+    char path[64];
+    std::snprintf(path, sizeof(path), "%s/%d/stat", proc, pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return;
+    buf[n] = '\0';
+
+    // "pid (comm) state ..." where comm may hold spaces and parentheses
+    char* p = std::strrchr(buf, ')');
+    if (!p || p[1] != ' ') return;
+    char state = p[2];
+    p += 3;
+    // After the state: fields 4..52 of proc(5); num_threads is 20, rss is 24
+    unsigned long long threads = 0, rss = 0;
+    for (int field = 4; field <= 24 && *p; ++field) {
+        while (*p == ' ') ++p;
+        char* end = nullptr;
+        unsigned long long v = std::strtoull(p, &end, 10);
+        if (field == 20) threads = v;
+        if (field == 24) rss = v;
+        p = end && end != p ? end : p + std::strcspn(p, " ");
+    }
+
+    totals.processes++;
+    totals.threads += threads;
+    totals.rss_pages += rss;
+    switch (state) {
+        case 'R': totals.running++; break;
+        case 'S': case 'I': totals.sleeping++; break;
+        case 'D': totals.blocked++; break;
+        case 'Z': totals.zombie++; break;
+        default: break;
+    }
+}
+
+// One scan of all processes, split into tasks of at most chunk pids.
+inline ProcessTotals scan_processes(TaskPool& pool, size_t chunk = 128, const char* proc = "/proc") {
+    std::vector<int> pids = list_pids(proc);
+    size_t tasks = (pids.size() + chunk - 1) / chunk;
+    std::vector<ProcessTotals> partial(tasks);
+    pool.parallel_for(tasks, [&](size_t t) {
+        size_t end = std::min(pids.size(), (t + 1) * chunk);
+        for (size_t i = t * chunk; i < end; ++i) scan_process(pids[i], partial[t], proc);
+    });
+    ProcessTotals totals;
+    for (const auto& part : partial) totals.merge(part);
+    return totals;
+}
+
+inline void process_scan_thread(const std::atomic<bool>& running, ReadingQueue& out, TaskPool& pool,
+                                std::chrono::milliseconds interval) {
+    std::cout << "[INFO] Process scan thread started (" << pool.size() << " workers)." << std::endl;
+    const double page_size = static_cast<double>(sysconf(_SC_PAGESIZE));
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        auto started = std::chrono::steady_clock::now();
+        ProcessTotals totals = scan_processes(pool);
+        double scan_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+        Reading reading;
+        reading.sensor_id = "processes";
+        reading.timestamp = timestamp();
+        reading.values = {
+            {"count", static_cast<double>(totals.processes)},
+            {"threads", static_cast<double>(totals.threads)},
+            {"running", static_cast<double>(totals.running)},
+            {"sleeping", static_cast<double>(totals.sleeping)},
+            {"blocked", static_cast<double>(totals.blocked)},
+            {"zombie", static_cast<double>(totals.zombie)},
+            {"rss_bytes", static_cast<double>(totals.rss_pages) * page_size},
+            {"scan_ms", scan_ms},
+        };
+        out.push(std::move(reading));
+
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+    std::cout << "[INFO] Process scan thread exiting." << std::endl;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "wire.hpp"
+
+// Bounded hand-off from producer threads to the thread that ships readings.
+// When full the oldest reading is dropped so fresh data wins.
+struct ReadingQueue {
+    explicit ReadingQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(Reading&& reading) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (queue.size() >= capacity) {
+            queue.pop_front();
+            dropped++;
+        }
+        queue.push_back(std::move(reading));
+    }
+
+    // Moves up to max readings into out; returns how many were moved.
+    size_t drain(std::vector<Reading>& out, size_t max) {
+        std::lock_guard<std::mutex> lock(mu);
+        size_t n = std::min(max, queue.size());
+        for (size_t i = 0; i < n; ++i) {
+            out.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        return n;
+    }
+
+    std::mutex mu;
+    std::deque<Reading> queue;
+    size_t capacity;
+    std::atomic<uint64_t> dropped{0};
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+// Run-queue latency: how long runnable threads wait for a CPU, which cpu
+// percent cannot show (a CPU at 100% with nobody waiting is busy, not
+// saturated). /proc/schedstat keeps, per CPU, the total nanoseconds tasks ran
+// and the total nanoseconds they sat runnable on the queue; the delta of the
+// latter per second of wall time is the average number of waiting tasks.
+//
+// Watched processes (SCHED_WATCH="nginx,postgres", matched on comm) get the
+// same numbers summed over all their threads from /proc/<pid>/task/<tid>/schedstat.
+// The pid list is refreshed every few ticks so restarts are picked up.
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "process_scan.hpp"
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+// Run time, run-queue wait and timeslice count, all cumulative
+struct SchedTimes {
+    uint64_t run_ns = 0;
+    uint64_t delay_ns = 0;
+    uint64_t slices = 0;
+};
+
+struct SchedstatSample {
+    std::chrono::steady_clock::time_point taken;
+    std::vector<uint32_t> cpu_ids;
+    std::vector<SchedTimes> cpus;
+};
+
+// "cpu<N> f1 .. f9": fields 7, 8 and 9 are run time, run delay and timeslices (schedstat v15).
+inline bool parse_schedstat(std::string_view text, SchedstatSample& out) {
+    out.cpu_ids.clear();
+    out.cpus.clear();
+    while (!text.empty()) {
+        size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+        if (line.substr(0, 3) != "cpu") continue;
+
+        const char* p = line.data() + 3;
+        const char* end = line.data() + line.size();
+        uint32_t id = 0;
+        p = std::from_chars(p, end, id).ptr;
+        uint64_t fields[9] = {};
+        size_t count = 0;
+        for (; count < 9; ++count) {
+            while (p < end && *p == ' ') ++p;
+            auto res = std::from_chars(p, end, fields[count]);
+            if (res.ec != std::errc()) break;
+            p = res.ptr;
+        }
+        if (count < 9) continue;
+        out.cpu_ids.push_back(id);
+        out.cpus.push_back({fields[6], fields[7], fields[8]});
+    }
+    return !out.cpus.empty();
+}
+
+// "run_ns delay_ns slices" from a per-task schedstat file.
+inline bool read_task_schedstat(const char* path, SchedTimes& out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char buf[96];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (n <= 0) return false;
+    const char* p = buf;
+    const char* end = buf + n;
+    uint64_t* fields[] = {&out.run_ns, &out.delay_ns, &out.slices};
+    for (uint64_t* field : fields) {
+        while (p < end && *p == ' ') ++p;
+        auto res = std::from_chars(p, end, *field);
+        if (res.ec != std::errc()) return false;
+        p = res.ptr;
+    }
+    return true;
+}
+
+// Values shared by the per-CPU and per-process readings.
+inline void sched_rate_values(const std::string& prefix, const SchedTimes& delta, double seconds, Reading& reading) {
+    double per_sec = seconds > 0 ? 1.0 / seconds : 0.0;
+    reading.values.emplace_back(prefix + "run_delay_ms_per_sec", delta.delay_ns / 1e6 * per_sec);
+    reading.values.emplace_back(prefix + "run_ms_per_sec", delta.run_ns / 1e6 * per_sec);
+    reading.values.emplace_back(prefix + "timeslices_per_sec", delta.slices * per_sec);
+    reading.values.emplace_back(prefix + "wait_per_slice_us", delta.slices > 0 ? delta.delay_ns / 1e3 / delta.slices : 0.0);
+}
+
+inline SchedTimes sched_delta(const SchedTimes& prev, const SchedTimes& cur) {
+    auto d = [](uint64_t a, uint64_t b) { return b >= a ? b - a : 0; };
+    return {d(prev.run_ns, cur.run_ns), d(prev.delay_ns, cur.delay_ns), d(prev.slices, cur.slices)};
+}
+
+// "schedstat" reading: per-CPU and machine-wide run-queue wait rates.
+inline Reading schedstat_reading(const SchedstatSample& prev, const SchedstatSample& cur) {
+    Reading reading;
+    reading.sensor_id = "schedstat";
+    reading.timestamp = timestamp();
+    double seconds = std::chrono::duration<double>(cur.taken - prev.taken).count();
+    SchedTimes total;
+    for (size_t i = 0; i < cur.cpus.size() && i < prev.cpus.size(); ++i) {
+        if (cur.cpu_ids[i] != prev.cpu_ids[i]) continue;  // hotplug reshuffled the rows; next tick lines up
+        SchedTimes delta = sched_delta(prev.cpus[i], cur.cpus[i]);
+        reading.values.emplace_back("cpu" + std::to_string(cur.cpu_ids[i]) + "_run_delay_ms_per_sec",
+                                    seconds > 0 ? delta.delay_ns / 1e6 / seconds : 0.0);
+        total.run_ns += delta.run_ns;
+        total.delay_ns += delta.delay_ns;
+        total.slices += delta.slices;
+    }
+    sched_rate_values("", total, seconds, reading);
+    return reading;
+}
+
+// Threads of the processes whose comm is one of the watched names.
+class SchedWatch {
+public:
+    explicit SchedWatch(std::vector<std::string> names) : names_(std::move(names)) {}
+
+    bool empty() const { return names_.empty(); }
+
+    void refresh_pids() {
+        pids_.assign(names_.size(), {});
+        char path[64];
+        char comm[64];
+        for (int pid : list_pids()) {
+            std::snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            ssize_t n = read(fd, comm, sizeof(comm));
+            close(fd);
+            if (n <= 0) continue;
+            std::string_view name(comm, comm[n - 1] == '\n' ? n - 1 : n);
+            for (size_t i = 0; i < names_.size(); ++i) {
+                if (name == names_[i]) pids_[i].push_back(pid);
+            }
+        }
+    }
+
+    // One "sched_<name>" reading per watched name; threads seen for the first time only prime.
+    void sample(ReadingQueue& out) {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - taken_).count();
+        bool primed = taken_.time_since_epoch().count() != 0;
+        taken_ = now;
+        std::unordered_map<uint64_t, SchedTimes> seen;
+        seen.reserve(last_.size());
+        std::string ts = timestamp();
+        char path[96];
+        for (size_t i = 0; i < names_.size(); ++i) {
+            SchedTimes total;
+            size_t threads = 0;
+            for (int pid : pids_[i]) {
+                std::snprintf(path, sizeof(path), "/proc/%d/task", pid);
+                DIR* dir = opendir(path);
+                if (!dir) continue;
+                while (dirent* entry = readdir(dir)) {
+                    if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+                    int tid = std::atoi(entry->d_name);
+                    std::snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+                    SchedTimes times;
+                    if (!read_task_schedstat(path, times)) continue;
+                    uint64_t key = (static_cast<uint64_t>(pid) << 32) | static_cast<uint32_t>(tid);
+                    seen[key] = times;
+                    threads++;
+                    auto it = last_.find(key);
+                    if (it == last_.end()) continue;
+                    SchedTimes delta = sched_delta(it->second, times);
+                    total.run_ns += delta.run_ns;
+                    total.delay_ns += delta.delay_ns;
+                    total.slices += delta.slices;
+                }
+                closedir(dir);
+            }
+            if (!primed) continue;
+            Reading reading;
+            reading.sensor_id = "sched_" + names_[i];
+            reading.timestamp = ts;
+            reading.values.emplace_back("processes", static_cast<double>(pids_[i].size()));
+            reading.values.emplace_back("threads", static_cast<double>(threads));
+            sched_rate_values("", total, seconds, reading);
+            out.push(std::move(reading));
+        }
+        last_.swap(seen);
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::vector<std::vector<int>> pids_;
+    std::unordered_map<uint64_t, SchedTimes> last_;  // (pid << 32 | tid) -> previous times
+    std::chrono::steady_clock::time_point taken_{};
+};
+
+inline void schedstat_thread(const std::atomic<bool>& running, ReadingQueue& out, std::vector<std::string> watched,
+                             std::chrono::milliseconds interval) {
+    std::cout << "[INFO] Scheduler latency thread started." << std::endl;
+    int fd = open("/proc/schedstat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) std::cerr << "[WARN] /proc/schedstat unavailable (kernel without CONFIG_SCHEDSTATS); per-CPU run delay disabled" << std::endl;
+    SchedWatch watch(std::move(watched));
+    if (fd < 0 && watch.empty()) return;
+
+    std::vector<char> buf(16384);
+    auto read_sample = [&](SchedstatSample& sample) {
+        ssize_t n;
+        while ((n = pread(fd, buf.data(), buf.size(), 0)) == static_cast<ssize_t>(buf.size())) buf.resize(buf.size() * 2);
+        sample.taken = std::chrono::steady_clock::now();
+        return n > 0 && parse_schedstat(std::string_view(buf.data(), static_cast<size_t>(n)), sample);
+    };
+    SchedstatSample prev, cur;
+    bool primed = fd >= 0 && read_sample(prev);
+    const int refresh_every = 10;  // ticks between pid list refreshes for watched processes
+    int tick = 0;
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        if (!watch.empty()) {
+            if (tick++ % refresh_every == 0) watch.refresh_pids();
+            watch.sample(out);
+        }
+        next += interval;
+        std::this_thread::sleep_until(next);
+        if (fd >= 0 && read_sample(cur)) {
+            if (primed) out.push(schedstat_reading(prev, cur));
+            primed = true;
+            std::swap(prev, cur);
+        }
+    }
+    if (fd >= 0) close(fd);
+    std::cout << "[INFO] Scheduler latency thread exiting." << std::endl;
+}
@@ -14,6 +14,29 @@
 #include <zmq.h>
 #include <zmq.hpp>
 #include <memory>
+#include "wire.hpp"
+#include "transport.hpp"
+#include "config.hpp"
+#include "reading_queue.hpp"
+#include "statsd.hpp"
+#include "shm_scrape.hpp"
+#include "sinks.hpp"
+#include "deadline_pool.hpp"
+#include "task_pool.hpp"
+#include "process_scan.hpp"
+#include "pipeline.hpp"
+#include "derived.hpp"
+#include "proc_stat.hpp"
+#include "vmstat.hpp"
+#include "irq_dist.hpp"
+#include "net_snmp.hpp"
+#include "tcp_diag.hpp"
+#include "schedstat.hpp"
+#include "cgroups.hpp"
+#include "kmsg.hpp"
+#include "log_tail.hpp"
+#include "probes.hpp"
+#include "subscriptions.hpp"
 
 
 using json = nlohmann::json;
@@ -30,80 +53,53 @@ struct SensorData {
 };
 
 SensorData sensor_reading;
-int write_counter = 0;
+std::atomic<int> write_counter{0};  // bumped by both writers, read by comm_thread
 
-// CPU usage calculation variables
-struct CpuTimes {
-    long user, nice, system, idle, iowait, irq, softirq, steal;
-};
-
-CpuTimes prev_cpu_times = {0};
+// CPU usage calculation variables: /proc/stat stays open and is read once per tick
+ProcStatReader proc_stat;
+ProcStatSample prev_cpu_times;
 
 void handle_sigint(int) {
     std::cout << "\n[INFO] SIGINT received. Exiting gracefully..." << std::endl;
     running = false;
 }
 
-std::string timestamp() {
-    std::time_t now = std::time(nullptr);
-    char buf[100];
-    std::strftime(buf, sizeof(buf), "%FT%TZ", std::gmtime(&now));
-    return std::string(buf);
-}
-
-CpuTimes read_cpu_times() {
-    std::ifstream file("/proc/stat");
-    std::string line;
-    CpuTimes times = {0};
-    
-    if (std::getline(file, line)) {
-        std::istringstream ss(line);
-        std::string cpu_label;
-        ss >> cpu_label >> times.user >> times.nice >> times.system >> times.idle 
-           >> times.iowait >> times.irq >> times.softirq >> times.steal;
-    }
-    
-    return times;
-}
-
-double calculate_cpu_usage() {
-    CpuTimes current = read_cpu_times();
-    
-    // Calculate differences
-    long prev_idle = prev_cpu_times.idle + prev_cpu_times.iowait;
-    long curr_idle = current.idle + current.iowait;
-    
-    long prev_non_idle = prev_cpu_times.user + prev_cpu_times.nice + prev_cpu_times.system + 
-                        prev_cpu_times.irq + prev_cpu_times.softirq + prev_cpu_times.steal;
-    long curr_non_idle = current.user + current.nice + current.system + 
-                        current.irq + current.softirq + current.steal;
-    
-    long prev_total = prev_idle + prev_non_idle;
-    long curr_total = curr_idle + curr_non_idle;
-    
-    long total_diff = curr_total - prev_total;
-    long idle_diff = curr_idle - prev_idle;
-    
-    double cpu_usage = 0.0;
-    if (total_diff > 0) {
-        cpu_usage = ((double)(total_diff - idle_diff) / total_diff) * 100.0;
-    }
-    
+double calculate_cpu_usage(const ProcStatSample& current) {
+    double cpu_usage = cpu_busy_percent(prev_cpu_times, current);
     prev_cpu_times = current;  // Update for next calculation
     
     std::cout << "[INFO] CPU usage: " << cpu_usage << "%" << std::endl;
     return cpu_usage;
 }
 
+// Which sensors someone downstream is watching; the others drop to a heartbeat under LAZY_SAMPLING
+static SubscriptionTable g_subscriptions;
+
+// Readings from producers other than the legacy slot (/proc/stat breakdown, StatsD, ...),
+// handed to the pipeline in bulk by comm_thread
+static ReadingQueue g_outbound(8192);
+
 void sensor_thread() {
     std::cout << "[INFO] CPU usage sensor thread started." << std::endl;
     
     // Initialize CPU times
-    prev_cpu_times = read_cpu_times();
+    proc_stat.read(prev_cpu_times);
+    ProcStatSample prev_breakdown = prev_cpu_times;
+    const std::chrono::milliseconds breakdown_interval(env_long("PROC_STAT_MS", 1000));
+    const bool raw_counters = env_string("COUNTER_MODE", "rates") == "raw";
     std::this_thread::sleep_for(std::chrono::seconds(1)); // Wait for initial reading
     
     while (running) {
-        double cpu_usage = calculate_cpu_usage();
+        // One read serves both the legacy usage value and the full breakdown
+        ProcStatSample current;
+        if (!proc_stat.read(current)) current = prev_cpu_times;
+        double cpu_usage = calculate_cpu_usage(current);
+        if (current.taken - prev_breakdown.taken >= breakdown_interval) {
+            // Raw mode ships the counters and leaves the rates to the processor
+            g_outbound.push(raw_counters ? proc_stat_counters_reading(current, sampled_at_now())
+                                         : proc_stat_reading(prev_breakdown, current));
+            prev_breakdown = current;
+        }
         
         sensor_reading.sensor_id = "cpu_usage_01";
         std::this_thread::sleep_for(std::chrono::microseconds(100)); // Deliberate delay
@@ -117,7 +113,7 @@ void sensor_thread() {
         sensor_reading.is_valid = true;
         write_counter++;
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Fast updates to increase contention
+        g_subscriptions.pace("cpu_usage_01", std::chrono::milliseconds(50), running); // Fast updates to increase contention
     }
     std::cout << "[INFO] CPU usage sensor thread exiting." << std::endl;
 }
@@ -138,10 +134,20 @@ double get_disk_usage_percent(const std::string& path = "/") {
     return percent;
 }
 
+// statvfs can block forever on a hung network or FUSE mount, so it runs on the
+// deadline pool; a stuck mount is skipped instead of stalling this thread.
+static DeadlinePool g_sampling(static_cast<size_t>(env_long("SAMPLE_WORKERS", 4)));
+
 void disk_usage_thread() {
     std::cout << "[INFO] Disk usage thread started." << std::endl;
+    const std::chrono::milliseconds deadline(env_long("SAMPLE_DEADLINE_MS", 2000));
     while (running) {
-        double usage = get_disk_usage_percent("/");
+        auto sample = g_sampling.run<double>("disk_usage_root", [] { return get_disk_usage_percent("/"); }, deadline);
+        if (sample.status != SampleStatus::ok) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(75));
+            continue;
+        }
+        double usage = sample.value;
     
         sensor_reading.sensor_id = "disk_usage_root";
         std::this_thread::sleep_for(std::chrono::microseconds(150)); // Deliberate delay
@@ -155,30 +161,47 @@ void disk_usage_thread() {
         sensor_reading.is_valid = true;
         write_counter++;
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(75)); // Fast updates to increase contention
+        g_subscriptions.pace("disk_usage_root", std::chrono::milliseconds(75), running); // Fast updates to increase contention
     }
     std::cout << "[INFO] Disk usage thread exiting." << std::endl;
 }
 
 
-// ZeroMQ globals for comm thread 
+// ZeroMQ context shared by the zmq sinks
 static std::unique_ptr<zmq::context_t> g_ctx;   
-static std::unique_ptr<zmq::socket_t>  g_sock; 
+static AgentIdentity g_identity;
+
+// Every reading fans out to the sinks listed in SINKS, each with its own queue and thread
+static SinkSet g_sinks;
+
+// Stages between comm_thread and the sinks, configured by PIPELINE
+static Pipeline g_pipeline;
+
+// Kernel log events go straight to the sinks' priority path; only the class totals ride the stats cycle
+static KmsgMonitor g_kmsg;
 
 void comm_thread() {
     std::cout << "[INFO] Communication thread started." << std::endl;
     int corruption_count = 0;
     int total_reads = 0;
+    int last_written = -1;  // write_counter at the last pass; the slot is only sent again once it moves
+    std::vector<Reading> batch;
+    const auto stats_interval = std::chrono::milliseconds(env_long("SINK_STATS_MS", 10000));
+    auto next_stats = std::chrono::steady_clock::now() + stats_interval;
     
     while (running) {
         SensorData current_reading;
         bool data_consistent = true;
         
+        // Under LAZY_SAMPLING the slot may go unwritten for a whole heartbeat
+        int written = write_counter.load();
+        bool fresh = written != last_written;
+        last_written = written;
         current_reading = sensor_reading;
         
         total_reads++;
         
-        if (current_reading.is_valid) {
+        if (current_reading.is_valid && fresh) {
             if ((current_reading.sensor_id == "cpu_usage_01" && (current_reading.value > 100 || current_reading.value < 0)) ||
                 (current_reading.sensor_id == "disk_usage_root" && current_reading.value > 100) ||
                 current_reading.sensor_id.empty() ||
@@ -191,36 +214,18 @@ void comm_thread() {
                          << ", Timestamp: " << current_reading.timestamp << std::endl;
             }
             
-            // Create and send JSON message
-            json message;
+            // Create the reading; the pipeline passes it on to the sinks
+            Reading reading;
+            reading.sensor_id = current_reading.sensor_id;
+            reading.timestamp = current_reading.timestamp;
+            reading.data_consistent = data_consistent;
             if (current_reading.sensor_id == "cpu_usage_01") {
-                message = {
-                    {"sensor_id", current_reading.sensor_id},
-                    {"timestamp", current_reading.timestamp},
-                    {"cpu_usage_percent", current_reading.value},
-                    {"data_consistent", data_consistent}
-                };
+                reading.values.emplace_back("cpu_usage_percent", current_reading.value);
             } else {
-                message = {
-                    {"sensor_id", current_reading.sensor_id},
-                    {"timestamp", current_reading.timestamp},
-                    {"disk_usage_percent", current_reading.value},
-                    {"data_consistent", data_consistent}
-                };
-            }
-            
-            std::string msg = message.dump() + "\n";
-
-            // send/recv via ZeroMQ REQ/REP  
-            std::string payload = message.dump();
-            try {
-                g_sock->send(zmq::buffer(payload), zmq::send_flags::none);
-                zmq::message_t reply;
-                auto ok = g_sock->recv(reply, zmq::recv_flags::none);
-                if (!ok) std::cerr << "[WARN] No reply from processor\n";
-            } catch (const std::exception& ex) {
-                std::cerr << "[ERROR] ZMQ send/recv failed: " << ex.what() << "\n";
+                reading.values.emplace_back("disk_usage_percent", current_reading.value);
             }
+
+            batch.push_back(std::move(reading));
             
             if (total_reads % 50 == 0) {
                 double corruption_rate = (double)corruption_count / total_reads * 100.0;
@@ -230,11 +235,26 @@ void comm_thread() {
             }
         }
 
+        g_outbound.drain(batch, g_outbound.capacity);
+        g_pipeline.push(batch);
+        batch.clear();
 
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_stats) {
+            batch = g_sinks.stats_readings(std::chrono::duration<double>(stats_interval).count());
+            batch.push_back(g_sampling.health_reading());
+            batch.push_back(g_pipeline.stats_reading());
+            if (g_kmsg.active()) batch.push_back(g_kmsg.stats_reading());
+            if (g_subscriptions.lazy()) batch.push_back(g_subscriptions.stats_reading());
+            g_sinks.publish(batch);
+            g_sinks.log_stats();
+            next_stats = now + stats_interval;
+        }
 
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
+    g_sinks.log_stats();
     double final_corruption_rate = total_reads > 0 ? (double)corruption_count / total_reads * 100.0 : 0.0;
     std::cout << "[FINAL STATS] Total reads: " << total_reads 
              << ", Corruptions: " << corruption_count 
@@ -247,16 +267,39 @@ int main() {
     std::signal(SIGINT, handle_sigint);
 
     // Build a communication mechanism with the processor [ADDED]
-    const std::string endpoint = "tcp://processor:5555";
-    std::cout << "[INFO] Connecting to processor at " << endpoint << std::endl;
+    // SINKS defaults to the processor over TRANSPORT (zmq or udp)
+    const std::string sinks = env_string("SINKS", env_string("TRANSPORT", "zmq"));
+    g_identity = agent_identity_from_env();
+    if (!g_pipeline.configure(env_string("PIPELINE", ""), static_cast<size_t>(env_long("PIPELINE_QUEUE", 8192)))) {
+        return 1;
+    }
+    const std::string derived = env_string("DERIVED", "");
+    if (!trim_spec(derived).empty()) {
+        auto stage = make_derived_stage(derived);
+        if (!stage) return 1;
+        g_pipeline.prepend(std::move(stage));
+    }
+    std::vector<std::string> pinned;
+    for (const std::string& glob : split_spec(env_string("SUBSCRIBE", ""), ',')) {
+        if (!trim_spec(glob).empty()) pinned.push_back(trim_spec(glob));
+    }
+    g_subscriptions.configure(env_long("LAZY_SAMPLING", 0) != 0, std::chrono::milliseconds(env_long("HEARTBEAT_MS", 30000)), pinned);
+    std::cout << "[INFO] Exporting to " << sinks << " as " << g_identity.host << std::endl;
     try {
         g_ctx  = std::make_unique<zmq::context_t>(1);
-        g_sock = std::make_unique<zmq::socket_t>(*g_ctx, zmq::socket_type::req);
-        g_sock->connect(endpoint);
+        g_sinks = make_sinks(sinks, *g_ctx, static_cast<size_t>(env_long("SINK_QUEUE", 8192)),
+                             [](const std::string& reply) { g_subscriptions.apply_reply(reply); });
     } catch (const std::exception& ex) {
         std::cerr << "[ERROR] Failed to connect to processor: " << ex.what() << std::endl;
         return 1;
     }
+    if (g_sinks.sinks.empty()) {
+        std::cerr << "[ERROR] No usable sinks in SINKS=" << sinks << std::endl;
+        return 1;
+    }
+    g_sinks.start(running, g_identity, std::chrono::milliseconds(env_long("SINK_FLUSH_MS", 100)));
+    g_pipeline.start(running, [](std::vector<Reading>& readings) { g_sinks.publish(readings); });
+    std::cout << "[INFO] Pipeline: " << g_pipeline.describe() << std::endl;
     std::cout << "[INFO] Connection created successfully." << std::endl;
 
 
@@ -264,10 +307,153 @@ int main() {
     std::thread t2(disk_usage_thread);
     std::thread t3(comm_thread);        
 
+    // StatsD ingest for applications on the host; STATSD_PORT=0 disables it
+    std::thread t4;
+    long statsd_port = env_long("STATSD_PORT", 8125);
+    if (statsd_port > 0 && statsd_port < 65536) {
+        t4 = std::thread(statsd_thread, std::cref(running), std::ref(g_outbound), static_cast<uint16_t>(statsd_port),
+                         std::chrono::milliseconds(env_long("STATSD_FLUSH_MS", 10000)),
+                         static_cast<size_t>(env_long("STATSD_MAX_METRICS", 16384)));
+    }
+
+    // Shared-memory counters registered by local applications; SHM_METRICS_SLOTS=0 disables it.
+    // SHM_METRICS_GROUP names the group whose members may publish.
+    std::thread t5;
+    long shm_slots = env_long("SHM_METRICS_SLOTS", 1024);
+    if (shm_slots > 0) {
+        ShmSegment segment = create_shm_segment(shm_metrics::segment_name(), static_cast<uint32_t>(shm_slots),
+                                                env_string("SHM_METRICS_GROUP", ""));
+        if (segment.header) {
+            t5 = std::thread(shm_scrape_thread, std::cref(running), std::ref(g_outbound), segment,
+                             std::chrono::milliseconds(env_long("SHM_SCRAPE_MS", 1000)));
+        }
+    }
+
+    // Parallel collectors share one work-stealing pool; PROC_SCAN_MS=0 disables the process scan
+    long workers = env_long("TASK_WORKERS", static_cast<long>(std::max(1u, std::thread::hardware_concurrency())));
+    TaskPool task_pool(static_cast<size_t>(std::max(1L, workers)));
+    std::thread t6;
+    long proc_scan_ms = env_long("PROC_SCAN_MS", 5000);
+    if (proc_scan_ms > 0) {
+        t6 = std::thread(process_scan_thread, std::cref(running), std::ref(g_outbound), std::ref(task_pool),
+                         std::chrono::milliseconds(proc_scan_ms));
+    }
+
+    // Paging/reclaim rates and load average; VMSTAT_MS=0 disables it
+    std::thread t7;
+    long vmstat_ms = env_long("VMSTAT_MS", 1000);
+    if (vmstat_ms > 0) {
+        t7 = std::thread(vmstat_thread, std::cref(running), std::ref(g_outbound), std::chrono::milliseconds(vmstat_ms));
+    }
+
+    // Per-CPU interrupt and softirq deltas; IRQ_DIST_MS=0 disables it. Quiet cells
+    // are only repeated when every sink delta-encodes them.
+    std::thread t8;
+    long irq_dist_ms = env_long("IRQ_DIST_MS", 5000);
+    if (irq_dist_ms > 0) {
+        t8 = std::thread(irq_distribution_thread, std::cref(running), std::ref(g_outbound),
+                         std::chrono::milliseconds(irq_dist_ms), g_sinks.all_send_deltas());
+    }
+
+    // TCP/UDP/IP stack counters as rates (raw with COUNTER_MODE=raw); NET_STACK_MS=0 disables it
+    std::thread t9;
+    long net_stack_ms = env_long("NET_STACK_MS", 5000);
+    if (net_stack_ms > 0) {
+        t9 = std::thread(net_snmp_thread, std::cref(running), std::ref(g_outbound), std::chrono::milliseconds(net_stack_ms),
+                         env_string("COUNTER_MODE", "rates") == "raw");
+    }
+
+    // Per-group RTT/retransmit summaries from sock_diag; TCP_DIAG_MS=0 disables it
+    std::thread t10;
+    long tcp_diag_ms = env_long("TCP_DIAG_MS", 10000);
+    if (tcp_diag_ms > 0) {
+        TcpGroupBy group_by = TcpGroupBy::remote_port;
+        std::string group = env_string("TCP_DIAG_GROUP", "remote_port");
+        if (!parse_tcp_group_by(group, group_by)) {
+            std::cerr << "[WARN] Unknown TCP_DIAG_GROUP '" << group << "', grouping by remote_port" << std::endl;
+        }
+        t10 = std::thread(tcp_diag_thread, std::cref(running), std::ref(g_outbound), group_by,
+                          static_cast<size_t>(env_long("TCP_DIAG_MAX_GROUPS", 20)), std::chrono::milliseconds(tcp_diag_ms));
+    }
+
+    // Run-queue wait per CPU and for SCHED_WATCH processes; SCHEDSTAT_MS=0 disables it
+    std::thread t11;
+    long schedstat_ms = env_long("SCHEDSTAT_MS", 1000);
+    if (schedstat_ms > 0) {
+        std::vector<std::string> watched;
+        for (const std::string& name : split_spec(env_string("SCHED_WATCH", ""), ',')) {
+            if (!trim_spec(name).empty()) watched.push_back(trim_spec(name));
+        }
+        t11 = std::thread(schedstat_thread, std::cref(running), std::ref(g_outbound), std::move(watched),
+                          std::chrono::milliseconds(schedstat_ms));
+    }
+
+    // Per-container CPU/memory/IO from the cgroup v2 tree; CGROUP_MS=0 disables it
+    std::thread t12;
+    long cgroup_ms = env_long("CGROUP_MS", 5000);
+    if (cgroup_ms > 0) {
+        std::vector<std::string> include;
+        for (const std::string& pattern : split_spec(env_string("CGROUP_INCLUDE", ""), ',')) {
+            if (!trim_spec(pattern).empty()) include.push_back(trim_spec(pattern));
+        }
+        if (include.empty()) include = default_container_patterns();
+        t12 = std::thread(cgroup_thread, std::cref(running), std::ref(g_outbound), std::ref(task_pool),
+                          env_string("CGROUP_ROOT", "/sys/fs/cgroup"), std::move(include),
+                          std::chrono::milliseconds(cgroup_ms));
+    }
+
+    // OOM kills, disk errors, hung tasks, ... from /dev/kmsg; KMSG_EVENTS=0 disables it
+    std::thread t13;
+    if (env_long("KMSG_EVENTS", 1) != 0) {
+        if (g_kmsg.open_source(env_string("KMSG_STATE", "/var/tmp/sensor-kmsg.state"))) {
+            t13 = std::thread([] {
+                g_kmsg.run(running, [](Reading&& event) { g_sinks.publish_urgent(std::move(event)); },
+                           std::chrono::milliseconds(env_long("KMSG_PERSIST_MS", 1000)));
+            });
+        } else {
+            std::cerr << "[WARN] Cannot read /dev/kmsg (needs CAP_SYSLOG in a container); kernel events disabled" << std::endl;
+        }
+    }
+
+    // Match counts per pattern from tailed log files; only runs when LOG_PATTERNS is set
+    std::thread t14;
+    std::string log_patterns = env_string("LOG_PATTERNS", "");
+    if (!log_patterns.empty()) {
+        t14 = std::thread(log_tail_thread, std::cref(running), std::ref(g_outbound), log_patterns,
+                          std::chrono::milliseconds(env_long("LOG_TAIL_MS", 10000)));
+    }
+
+    // TCP connect / HTTP GET checks against PROBES targets; only runs when PROBES is set
+    std::thread t15;
+    std::vector<std::string> probe_entries;
+    for (const std::string& entry : split_spec(env_string("PROBES", ""), ',')) probe_entries.push_back(trim_spec(entry));
+    std::vector<ProbeTarget> probe_targets = parse_probe_targets(probe_entries);
+    if (!probe_targets.empty()) {
+        t15 = std::thread(probe_thread, std::cref(running), std::ref(g_outbound), std::move(probe_targets),
+                          std::chrono::milliseconds(env_long("PROBE_MS", 10000)),
+                          std::chrono::milliseconds(env_long("PROBE_TIMEOUT_MS", 2000)),
+                          static_cast<size_t>(env_long("PROBE_CONCURRENCY", 512)));
+    }
+
     t1.join();
     t2.join();
     running = false;
     t3.join();  
+    g_pipeline.join();
+    g_sinks.join();
+    if (t4.joinable()) t4.join();
+    if (t5.joinable()) t5.join();
+    if (t6.joinable()) t6.join();
+    if (t7.joinable()) t7.join();
+    if (t8.joinable()) t8.join();
+    if (t9.joinable()) t9.join();
+    if (t10.joinable()) t10.join();
+    if (t11.joinable()) t11.join();
+    if (t12.joinable()) t12.join();
+    g_kmsg.stop();
+    if (t13.joinable()) t13.join();
+    if (t14.joinable()) t14.join();
+    if (t15.joinable()) t15.join();
 
     std::cout << "[INFO] Sensor service stopped." << std::endl;
     return 0;
@@ -0,0 +1,171 @@
+#pragma once
+
+// Header-only client for publishing application metrics through the agent.
+//
+// The agent owns a POSIX shared-memory segment holding a table of metric
+// slots. An application opens it, registers counters and gauges by name and
+// then updates them with plain atomic operations: no syscall, no lock, no
+// allocation on the hot path. The agent scrapes the table on its own schedule
+// and forwards the values over its transport.
+//
+//     shm_metrics::Registry registry;                 // opens the agent's segment
+//     auto requests = registry.counter("http_requests");
+//     auto inflight = registry.gauge("http_inflight");
+//     requests.inc();
+//     inflight.set(12);
+//
+// If the segment does not exist (agent not running) or is full, handles are
+// bound to a private dummy slot so instrumentation never fails. The segment is
+// mode 0660: the application must run as the agent's user or in its
+// SHM_METRICS_GROUP.
+//
+// Slots are never freed. A restarted application finds its names again and
+// reuses their slots, so the table grows with the number of distinct names,
+// not with process restarts; size SHM_METRICS_SLOTS for the names in use.
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shm_metrics {
+
+constexpr uint32_t kMagic = 0x314D4C54;  // "TLM1"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kNameSize = 40;
+constexpr const char* kDefaultSegment = "/telemetrylink-metrics";
+
+enum Kind : uint32_t { kCounter = 1, kGauge = 2 };
+enum State : uint32_t { kFree = 0, kReady = 2 };
+
+// One metric per cache line so updates from different threads never share a line.
+struct alignas(64) Slot {
+    std::atomic<uint32_t> state;
+    uint32_t kind;
+    uint32_t reserved[2];
+    char name[kNameSize];
+    std::atomic<uint64_t> value;  // counter: count; gauge: bit pattern of a double
+};
+static_assert(sizeof(Slot) == 64, "slot must fill exactly one cache line");
+
+struct alignas(64) Header {
+    std::atomic<uint32_t> magic;  // written last by the agent once the table is initialised
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t slot_size;
+    std::atomic<uint32_t> next_free;
+};
+
+inline size_t segment_size(uint32_t capacity) {
+    return sizeof(Header) + static_cast<size_t>(capacity) * sizeof(Slot);
+}
+
+inline Slot* slots(Header* header) {
+    return reinterpret_cast<Slot*>(reinterpret_cast<char*>(header) + sizeof(Header));
+}
+
+inline const char* segment_name() {
+    const char* name = std::getenv("TELEMETRYLINK_SHM");
+    return name && *name ? name : kDefaultSegment;
+}
+
+inline double bits_to_double(uint64_t bits) {
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+inline uint64_t double_to_bits(double d) {
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+class Counter {
+public:
+    explicit Counter(std::atomic<uint64_t>* value) : value_(value) {}
+    void inc(uint64_t n = 1) { value_->fetch_add(n, std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t>* value_;
+};
+
+class Gauge {
+public:
+    explicit Gauge(std::atomic<uint64_t>* value) : value_(value) {}
+    void set(double v) { value_->store(double_to_bits(v), std::memory_order_relaxed); }
+    void add(double delta) {
+        uint64_t old = value_->load(std::memory_order_relaxed);
+        while (!value_->compare_exchange_weak(old, double_to_bits(bits_to_double(old) + delta),
+                                              std::memory_order_relaxed)) {}
+    }
+private:
+    std::atomic<uint64_t>* value_;
+};
+
+class Registry {
+public:
+    explicit Registry(const char* name = segment_name()) {
+        int fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                auto* header = static_cast<Header*>(p);
+                if (header->magic.load(std::memory_order_acquire) == kMagic && header->version == kVersion &&
+                    segment_size(header->capacity) <= static_cast<size_t>(st.st_size)) {
+                    header_ = header;
+                } else {
+                    munmap(p, st.st_size);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    bool connected() const { return header_ != nullptr; }
+
+    Counter counter(std::string_view name) { return Counter(slot_value(name, kCounter)); }
+    Gauge gauge(std::string_view name) { return Gauge(slot_value(name, kGauge)); }
+
+private:
+    // Reuses a slot already registered under the same name and kind (possibly by
+    // another process), otherwise claims the next free one. Two processes
+    // registering the same new name at the same instant may end up with two
+    // slots; the agent sums counters with equal names when it scrapes.
+    std::atomic<uint64_t>* slot_value(std::string_view name, Kind kind) {
+        if (!header_ || name.empty() || name.size() >= kNameSize) return &dummy_;
+        Slot* table = slots(header_);
+        uint32_t used = std::min(header_->next_free.load(std::memory_order_acquire), header_->capacity);
+        for (uint32_t i = 0; i < used; ++i) {
+            Slot& slot = table[i];
+            if (slot.state.load(std::memory_order_acquire) == kReady && slot.kind == kind &&
+                std::string_view(slot.name) == name) {
+                return &slot.value;
+            }
+        }
+        uint32_t index = header_->next_free.fetch_add(1, std::memory_order_acq_rel);
+        if (index >= header_->capacity) return &dummy_;
+        Slot& slot = table[index];
+        slot.kind = kind;
+        std::memcpy(slot.name, name.data(), name.size());
+        slot.name[name.size()] = '\0';
+        slot.value.store(kind == kGauge ? double_to_bits(0.0) : 0, std::memory_order_relaxed);
+        slot.state.store(kReady, std::memory_order_release);
+        return &slot.value;
+    }
+
+    // Never unmapped: handles handed out must stay valid for the life of the process
+    Header* header_ = nullptr;
+    static inline std::atomic<uint64_t> dummy_{0};
+};
+
+}  // namespace shm_metrics
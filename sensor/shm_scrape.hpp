@@ -0,0 +1,142 @@
+#pragma once
+
+// Agent side of the shared-memory metrics API (see shm_metrics.hpp): creates
+// the segment and scrapes it on the sampling schedule.
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <grp.h>
+#include "reading_queue.hpp"
+#include "shm_metrics.hpp"
+#include "wire.hpp"
+
+// The agent's own view of the segment. Everything in the mapping is writable
+// by the applications, so the bounds the scraper uses come from here, never
+// from the shared header.
+struct ShmSegment {
+    shm_metrics::Header* header = nullptr;
+    uint32_t capacity = 0;
+    size_t size = 0;  // bytes mapped
+    int fd = -1;      // kept open to check the size before every scrape
+};
+
+// Creates (or adopts, if an agent restart finds a compatible one it owns) the
+// segment, mode 0660 and owned by owner_group when one is given: applications
+// publishing metrics must run as the agent's user or in that group.
+// Returns a segment with a null header on failure.
+inline ShmSegment create_shm_segment(const char* name, uint32_t capacity, const std::string& owner_group) {
+    using namespace shm_metrics;
+    ShmSegment segment;
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0660);
+    if (fd < 0) {
+        std::cerr << "[ERROR] shm_open(" << name << ") failed: " << std::strerror(errno) << std::endl;
+        return segment;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_uid != geteuid()) {
+        // Someone else created the name first; adopting it would let them resize it under us
+        std::cerr << "[ERROR] Shared-memory segment " << name << " is not owned by the agent's user" << std::endl;
+        close(fd);
+        return segment;
+    }
+    if (!owner_group.empty()) {
+        struct group* entry = getgrnam(owner_group.c_str());
+        if (!entry || fchown(fd, static_cast<uid_t>(-1), entry->gr_gid) != 0) {
+            std::cerr << "[ERROR] Cannot give shared-memory segment to group " << owner_group << std::endl;
+            close(fd);
+            return segment;
+        }
+    }
+    fchmod(fd, 0660);
+    size_t size = segment_size(capacity);
+    bool adopt = static_cast<size_t>(st.st_size) == size;
+    if (!adopt && ftruncate(fd, size) != 0) {
+        std::cerr << "[ERROR] Sizing shared-memory segment failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return segment;
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "[ERROR] Mapping shared-memory segment failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return segment;
+    }
+    segment = {static_cast<Header*>(p), capacity, size, fd};
+    Header* header = segment.header;
+    if (adopt && header->magic.load(std::memory_order_acquire) == kMagic && header->version == kVersion &&
+        header->capacity == capacity && header->slot_size == sizeof(Slot)) {
+        std::cout << "[INFO] Adopted shared-memory segment " << name << " with "
+                  << std::min(header->next_free.load(), capacity) << " registered metrics." << std::endl;
+        return segment;
+    }
+    header->magic.store(0, std::memory_order_relaxed);
+    std::memset(static_cast<void*>(slots(header)), 0, static_cast<size_t>(capacity) * sizeof(Slot));
+    header->version = kVersion;
+    header->capacity = capacity;
+    header->slot_size = sizeof(Slot);
+    header->next_free.store(0, std::memory_order_relaxed);
+    header->magic.store(kMagic, std::memory_order_release);
+    return segment;
+}
+
+// Every interval, turns all registered slots into one "app_metrics" reading:
+// gauges as <name>, counters as <name>_total and <name>_rate (per second).
+inline void shm_scrape_thread(const std::atomic<bool>& running, ReadingQueue& out, ShmSegment segment,
+                              std::chrono::milliseconds interval) {
+    using namespace shm_metrics;
+    std::cout << "[INFO] Shared-memory metrics scraper started (" << segment.capacity << " slots)." << std::endl;
+    std::unordered_map<std::string, uint64_t> previous_totals;
+    std::unordered_map<std::string, uint64_t> totals;
+    std::vector<std::pair<std::string, double>> gauges;
+    auto last = std::chrono::steady_clock::now();
+    bool shrunk = false;
+
+    while (running) {
+        std::this_thread::sleep_for(interval);
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        // Touching pages past a truncated file's end is SIGBUS, so a shrunk segment is not read
+        struct stat st;
+        if (fstat(segment.fd, &st) != 0 || static_cast<size_t>(st.st_size) < segment.size) {
+            if (!shrunk) std::cerr << "[ERROR] Shared-memory segment was truncated; not scraping it" << std::endl;
+            shrunk = true;
+            continue;
+        }
+        shrunk = false;
+
+        totals.clear();
+        gauges.clear();
+        Slot* table = slots(segment.header);
+        uint32_t used = std::min(segment.header->next_free.load(std::memory_order_acquire), segment.capacity);
+        for (uint32_t i = 0; i < used; ++i) {
+            Slot& slot = table[i];
+            if (slot.state.load(std::memory_order_acquire) != kReady) continue;
+            uint64_t value = slot.value.load(std::memory_order_relaxed);
+            std::string name(slot.name, strnlen(slot.name, kNameSize));
+            if (slot.kind == kCounter) totals[name] += value;  // duplicates of a name are summed
+            else gauges.emplace_back(std::move(name), bits_to_double(value));
+        }
+        if (totals.empty() && gauges.empty()) continue;
+
+        Reading reading;
+        reading.sensor_id = "app_metrics";
+        reading.timestamp = timestamp();
+        for (const auto& [name, total] : totals) {
+            auto prev = previous_totals.find(name);
+            double rate = prev != previous_totals.end() && total >= prev->second ? (total - prev->second) / seconds : 0.0;
+            reading.values.emplace_back(name + "_total", static_cast<double>(total));
+            reading.values.emplace_back(name + "_rate", rate);
+        }
+        for (auto& gauge : gauges) reading.values.push_back(std::move(gauge));
+        out.push(std::move(reading));
+        previous_totals.swap(totals);
+    }
+    std::cout << "[INFO] Shared-memory metrics scraper exiting." << std::endl;
+}
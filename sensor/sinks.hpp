@@ -0,0 +1,652 @@
+#pragma once
+
+// Fan-out of the reading stream to several exporters. Every sink owns a
+// bounded queue, an encoder turning a batch into payloads, a writer shipping
+// them and a thread driving both. A sink whose destination is slow or down
+// only fills (and then drops the oldest entries of) its own queue; sampling
+// and the other sinks carry on.
+//
+// SINKS lists them, comma separated, as kind[:target]:
+//   zmq[:endpoint]          processor over REQ/REP, one JSON array per batch (default);
+//                           wide readings are delta-encoded, see delta.hpp
+//   udp[:host:port]         processor over UDP datagrams, see udp_transport.hpp
+//   file:/path              JSON lines appended to a local file
+//   influx:host:port        Influx line protocol over TCP (Telegraf socket_listener)
+//   otlp:host:port[/path]   OTLP/HTTP protobuf metrics, POSTed to /v1/metrics by default
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <zmq.hpp>
+#include "config.hpp"
+#include "delta.hpp"
+#include "reading_queue.hpp"
+#include "transport.hpp"
+#include "udp_transport.hpp"
+#include "wire.hpp"
+
+// Turns a batch of readings into one or more payloads for a writer.
+struct Encoder {
+    virtual ~Encoder() = default;
+    virtual void encode(const std::vector<Reading>& batch, const AgentIdentity& id,
+                        std::vector<std::string>& payloads) = 0;
+    // Some payloads of the last batch were not delivered.
+    virtual void delivery_failed() {}
+    // Encoder-specific totals for the sink's stats reading; called from another thread.
+    virtual void append_stats(std::vector<std::pair<std::string, double>>& values) const { (void)values; }
+    // Wide readings go out as deltas against the previous one, so unchanged values cost next to nothing.
+    virtual bool sends_deltas() const { return false; }
+};
+
+// Ships payloads; returns how many of them were delivered.
+struct Writer {
+    virtual ~Writer() = default;
+    virtual size_t write(const std::vector<std::string>& payloads) = 0;
+};
+
+// ---- encoders ---------------------------------------------------------------
+
+struct JsonBatchEncoder : Encoder {
+    void encode(const std::vector<Reading>& batch, const AgentIdentity& id, std::vector<std::string>& payloads) override {
+        std::string out;
+        out.reserve(last_size);
+        encoder.append_batch(out, batch, id);
+        last_size = out.size();
+        payloads.push_back(std::move(out));
+    }
+    ReadingEncoder encoder;
+    size_t last_size = 0;
+};
+
+// JsonBatchEncoder with wide readings (at least min_values values) delta-encoded, see delta.hpp.
+struct DeltaJsonBatchEncoder : Encoder {
+    DeltaJsonBatchEncoder(size_t min_values, uint32_t keyframe_every) : min_values(min_values), delta(keyframe_every) {}
+    void encode(const std::vector<Reading>& batch, const AgentIdentity& id, std::vector<std::string>& payloads) override {
+        std::string out;
+        out.reserve(last_size);
+        out.push_back('[');
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (i > 0) out.push_back(',');
+            if (batch[i].values.size() >= min_values) delta.append(out, batch[i], id);
+            else encoder.append(out, batch[i], id);
+        }
+        out.push_back(']');
+        last_size = out.size();
+        payloads.push_back(std::move(out));
+    }
+    void delivery_failed() override { delta.resync(); }
+    bool sends_deltas() const override { return true; }
+    size_t min_values;
+    DeltaEncoder delta;
+    ReadingEncoder encoder;
+    size_t last_size = 0;
+};
+
+struct JsonLinesEncoder : Encoder {
+    void encode(const std::vector<Reading>& batch, const AgentIdentity& id, std::vector<std::string>& payloads) override {
+        std::string out;
+        out.reserve(last_size);
+        for (const auto& reading : batch) {
+            encoder.append(out, reading, id);
+            out.push_back('\n');
+        }
+        last_size = out.size();
+        payloads.push_back(std::move(out));
+    }
+    ReadingEncoder encoder;
+    size_t last_size = 0;
+};
+
+struct UdpDatagramEncoder : Encoder {
+    explicit UdpDatagramEncoder(size_t datagram_size) : datagram_size(datagram_size) {}
+    void encode(const std::vector<Reading>& batch, const AgentIdentity& id, std::vector<std::string>& payloads) override {
+        uint64_t oversize = stream.oversize;
+        pack_datagrams(stream, batch, id, datagram_size, payloads);
+        if (stream.oversize != oversize) {
+            std::cerr << "[WARN] UDP sink dropped " << stream.oversize - oversize
+                      << " values too large for any datagram (" << stream.oversize << " so far)" << std::endl;
+        }
+        split.store(stream.split, std::memory_order_relaxed);
+        dropped.store(stream.oversize, std::memory_order_relaxed);
+    }
+    void append_stats(std::vector<std::pair<std::string, double>>& values) const override {
+        values.emplace_back("readings_split_total", static_cast<double>(split.load(std::memory_order_relaxed)));
+        values.emplace_back("oversize_total", static_cast<double>(dropped.load(std::memory_order_relaxed)));
+    }
+    UdpStream stream;
+    size_t datagram_size;
+    std::atomic<uint64_t> split{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+// Reading timestamps are "%FT%TZ" strings; exporters that want epoch time parse them back.
+inline uint64_t timestamp_unix_ns(const std::string& ts) {
+    std::tm tm{};
+    std::time_t seconds = 0;
+    if (strptime(ts.c_str(), "%Y-%m-%dT%H:%M:%SZ", &tm)) seconds = timegm(&tm);
+    else seconds = std::time(nullptr);
+    return static_cast<uint64_t>(seconds) * 1000000000ull;
+}
+
+// measurement = sensor id, tags = host and agent labels, fields = reading values.
+struct InfluxLineEncoder : Encoder {
+    static void escape(std::string& out, const std::string& s, bool measurement) {
+        for (char c : s) {
+            if (c == ',' || c == ' ' || (c == '=' && !measurement)) out.push_back('\\');
+            out.push_back(c);
+        }
+    }
+
+    void encode(const std::vector<Reading>& batch, const AgentIdentity& id, std::vector<std::string>& payloads) override {
+        std::string tags;
+        if (!id.host.empty()) {
+            tags += ",host=";
+            escape(tags, id.host, false);
+        }
+        for (const auto& [key, value] : id.labels) {
+            tags.push_back(',');
+            escape(tags, key, false);
+            tags.push_back('=');
+            escape(tags, value, false);
+        }
+
+        std::string out;
+        char number[32];
+        for (const auto& reading : batch) {
+            escape(out, reading.sensor_id, true);
+            out += tags;
+            out += reading.data_consistent ? " data_consistent=true" : " data_consistent=false";
+            for (const auto& [key, value] : reading.values) {
+                if (!std::isfinite(value)) continue;  // line protocol has no NaN/Inf
+                out.push_back(',');
+                escape(out, key, false);
+                out.push_back('=');
+                out.append(number, std::snprintf(number, sizeof(number), "%.17g", value));
+            }
+            out.push_back(' ');
+            out += std::to_string(timestamp_unix_ns(reading.timestamp));
+            out.push_back('\n');
+        }
+        payloads.push_back(std::move(out));
+    }
+};
+
+// Minimal protobuf wire-format writer: just what the OTLP metrics messages need.
+struct ProtoWriter {
+    std::string buf;
+
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+            v >>= 7;
+        }
+        buf.push_back(static_cast<char>(v));
+    }
+    void tag(uint32_t field, uint32_t wire_type) { varint((field << 3) | wire_type); }
+    void fixed64(uint32_t field, uint64_t v) {
+        tag(field, 1);
+        for (int i = 0; i < 8; ++i) buf.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+    void number(uint32_t field, double d) {
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        fixed64(field, bits);
+    }
+    void boolean(uint32_t field, bool b) {
+        tag(field, 0);
+        varint(b ? 1 : 0);
+    }
+    void bytes(uint32_t field, const std::string& s) {
+        tag(field, 2);
+        varint(s.size());
+        buf += s;
+    }
+};
+
+// ExportMetricsServiceRequest with one ResourceMetrics (host and labels as
+// resource attributes) and one gauge per value name, a data point per reading.
+struct OtlpEncoder : Encoder {
+    static std::string string_attribute(const std::string& key, const std::string& value) {
+        ProtoWriter any, kv;
+        any.bytes(1, value);          // AnyValue.string_value
+        kv.bytes(1, key);             // KeyValue.key
+        kv.bytes(2, any.buf);         // KeyValue.value
+        return kv.buf;
+    }
+
+    static std::string bool_attribute(const std::string& key, bool value) {
+        ProtoWriter any, kv;
+        any.boolean(2, value);        // AnyValue.bool_value
+        kv.bytes(1, key);
+        kv.bytes(2, any.buf);
+        return kv.buf;
+    }
+
+    void encode(const std::vector<Reading>& batch, const AgentIdentity& id, std::vector<std::string>& payloads) override {
+        std::map<std::string, ProtoWriter> gauges;  // value name -> Gauge message
+        for (const auto& reading : batch) {
+            uint64_t time_ns = timestamp_unix_ns(reading.timestamp);
+            for (const auto& [key, value] : reading.values) {
+                ProtoWriter point;
+                point.fixed64(3, time_ns);                                          // time_unix_nano
+                point.number(4, value);                                             // as_double
+                point.bytes(7, string_attribute("sensor_id", reading.sensor_id));   // attributes
+                if (!reading.data_consistent) point.bytes(7, bool_attribute("data_consistent", false));
+                gauges[key].bytes(1, point.buf);                                    // Gauge.data_points
+            }
+        }
+
+        ProtoWriter resource, scope, scope_metrics, resource_metrics, request;
+        if (!id.host.empty()) resource.bytes(1, string_attribute("host.name", id.host));
+        for (const auto& [key, value] : id.labels) resource.bytes(1, string_attribute(key, value));
+        scope.bytes(1, "telemetrylink-sensor");                 // InstrumentationScope.name
+        scope_metrics.bytes(1, scope.buf);
+        for (const auto& [name, gauge] : gauges) {
+            ProtoWriter metric;
+            metric.bytes(1, name);                              // Metric.name
+            metric.bytes(5, gauge.buf);                         // Metric.gauge
+            scope_metrics.bytes(2, metric.buf);
+        }
+        resource_metrics.bytes(1, resource.buf);
+        resource_metrics.bytes(2, scope_metrics.buf);
+        request.bytes(1, resource_metrics.buf);
+        payloads.push_back(std::move(request.buf));
+    }
+};
+
+// ---- writers ----------------------------------------------------------------
+
+// Receives the processor's reply to each batch (subscription leases, ...).
+using ReplyHandler = std::function<void(const std::string&)>;
+
+struct ZmqWriter : Writer {
+    ZmqWriter(zmq::socket_t sock, ReplyHandler on_reply) : sock(std::move(sock)), on_reply(std::move(on_reply)) {}
+    size_t write(const std::vector<std::string>& payloads) override {
+        size_t delivered = 0;
+        for (const auto& payload : payloads) {
+            if (!send_to_processor(sock, payload, on_reply ? &reply : nullptr)) continue;
+            delivered++;
+            if (on_reply) on_reply(reply);
+        }
+        return delivered;
+    }
+    zmq::socket_t sock;
+    ReplyHandler on_reply;
+    std::string reply;
+};
+
+struct UdpWriter : Writer {
+    explicit UdpWriter(int fd) : fd(fd) {}
+    ~UdpWriter() override { if (fd >= 0) close(fd); }
+    size_t write(const std::vector<std::string>& payloads) override { return send_datagrams(fd, payloads); }
+    int fd;
+};
+
+struct FileWriter : Writer {
+    explicit FileWriter(std::string path) : path(std::move(path)) {}
+    ~FileWriter() override { if (file) std::fclose(file); }
+    size_t write(const std::vector<std::string>& payloads) override {
+        if (!file && !(file = std::fopen(path.c_str(), "a"))) return 0;
+        size_t delivered = 0;
+        for (const auto& payload : payloads) {
+            if (std::fwrite(payload.data(), 1, payload.size(), file) == payload.size()) delivered++;
+        }
+        if (std::fflush(file) != 0) {
+            std::fclose(file);  // reopened on the next batch, e.g. after the disk filled up
+            file = nullptr;
+        }
+        return delivered;
+    }
+    std::string path;
+    std::FILE* file = nullptr;
+};
+
+// TCP connection opened lazily and re-established after errors, at most once a second.
+struct TcpConnection {
+    explicit TcpConnection(std::string host_port) : host_port(std::move(host_port)) {}
+    ~TcpConnection() { reset(); }
+
+    bool ensure() {
+        if (fd >= 0) return true;
+        auto now = std::chrono::steady_clock::now();
+        if (now < retry_at) return false;
+        retry_at = now + std::chrono::seconds(1);
+        fd = open_connected_socket(host_port, SOCK_STREAM);
+        if (fd < 0) return false;
+        timeval timeout{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        return true;
+    }
+
+    bool send_all(const std::string& data) {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            ssize_t n = ::send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                reset();
+                return false;
+            }
+            pos += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void reset() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    std::string host_port;
+    int fd = -1;
+    std::chrono::steady_clock::time_point retry_at{};
+};
+
+struct TcpWriter : Writer {
+    explicit TcpWriter(std::string host_port) : conn(std::move(host_port)) {}
+    size_t write(const std::vector<std::string>& payloads) override {
+        size_t delivered = 0;
+        for (const auto& payload : payloads) {
+            if (!conn.ensure() || !conn.send_all(payload)) break;
+            delivered++;
+        }
+        return delivered;
+    }
+    TcpConnection conn;
+};
+
+// HTTP/1.1 POST per payload over a kept-alive connection; 2xx counts as delivered.
+struct HttpPostWriter : Writer {
+    HttpPostWriter(std::string host_port, std::string path, std::string content_type)
+        : conn(host_port), host(host_port), path(std::move(path)), content_type(std::move(content_type)) {}
+
+    size_t write(const std::vector<std::string>& payloads) override {
+        size_t delivered = 0;
+        for (const auto& payload : payloads) {
+            if (!conn.ensure()) break;
+            std::string request = "POST " + path + " HTTP/1.1\r\nHost: " + host + "\r\nContent-Type: " + content_type +
+                                  "\r\nContent-Length: " + std::to_string(payload.size()) + "\r\n\r\n";
+            request += payload;
+            if (!conn.send_all(request)) break;
+            int status = read_response();
+            if (status < 0) break;
+            if (status >= 200 && status < 300) delivered++;
+            else std::cerr << "[WARN] " << host << path << " answered HTTP " << status << std::endl;
+        }
+        return delivered;
+    }
+
+    // Status code of the response, -1 if the connection failed. Only bodies with a
+    // Content-Length can be skipped; anything else closes the connection afterwards.
+    int read_response() {
+        std::string response;
+        char buf[4096];
+        size_t header_end;
+        while ((header_end = response.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                conn.reset();
+                return -1;
+            }
+            response.append(buf, n);
+        }
+        int status = response.size() > 12 ? std::atoi(response.c_str() + 9) : 0;
+        std::string headers = response.substr(0, header_end);
+        for (auto& c : headers) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        size_t cl = headers.find("content-length:");
+        if (cl == std::string::npos || headers.find("connection: close") != std::string::npos) {
+            conn.reset();
+            return status;
+        }
+        size_t body = static_cast<size_t>(std::atol(headers.c_str() + cl + 15));
+        size_t have = response.size() - header_end - 4;
+        while (have < body) {
+            ssize_t n = recv(conn.fd, buf, std::min(sizeof(buf), body - have), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                conn.reset();
+                break;
+            }
+            have += static_cast<size_t>(n);
+        }
+        return status;
+    }
+
+    TcpConnection conn;
+    std::string host;
+    std::string path;
+    std::string content_type;
+};
+
+// ---- sinks ------------------------------------------------------------------
+
+struct Sink {
+    Sink(std::string name, std::unique_ptr<Encoder> encoder, std::unique_ptr<Writer> writer,
+         size_t queue_capacity, size_t max_batch)
+        : name(std::move(name)), encoder(std::move(encoder)), writer(std::move(writer)),
+          queue(queue_capacity), max_batch(max_batch) {}
+
+    void run(const std::atomic<bool>& running, const AgentIdentity& id, std::chrono::milliseconds flush_interval) {
+        std::vector<Reading> batch;
+        std::vector<std::string> payloads;
+        while (running) {
+            batch.clear();
+            // Priority-path readings go out first, in a batch of their own, ahead of any backlog
+            if (urgent.drain(batch, max_batch) == 0 && queue.drain(batch, max_batch) == 0) {
+                std::unique_lock<std::mutex> lock(wake_mu);
+                wake.wait_for(lock, flush_interval, [this] { return woken; });
+                woken = false;
+                continue;
+            }
+            payloads.clear();
+            encoder->encode(batch, id, payloads);
+            if (payloads.empty()) continue;
+            size_t delivered = writer->write(payloads);
+            if (delivered < payloads.size()) encoder->delivery_failed();
+            size_t bytes = 0;
+            for (size_t i = 0; i < payloads.size(); ++i) bytes += payloads[i].size();
+            // Payloads carry roughly equal shares of the batch, so partial delivery is prorated
+            uint64_t sent = batch.size() * delivered / payloads.size();
+            readings_sent += sent;
+            readings_failed += batch.size() - sent;
+            bytes_sent += bytes * delivered / payloads.size();
+        }
+    }
+
+    std::string name;
+    std::unique_ptr<Encoder> encoder;
+    std::unique_ptr<Writer> writer;
+    ReadingQueue queue;
+    ReadingQueue urgent{1024};  // events that must not wait for the flush interval
+    size_t max_batch;
+    std::thread thread;
+    std::mutex wake_mu;
+    std::condition_variable wake;
+    bool woken = false;  // guarded by wake_mu
+    std::atomic<uint64_t> readings_sent{0};
+    std::atomic<uint64_t> readings_failed{0};
+    std::atomic<uint64_t> bytes_sent{0};
+    uint64_t last_sent = 0;  // for the rate in stats_readings(); touched by one thread only
+};
+
+struct SinkSet {
+    // Every sink gets its own copy; the last one takes the original.
+    void publish(Reading&& reading) {
+        for (size_t i = 0; i + 1 < sinks.size(); ++i) sinks[i]->queue.push(Reading(reading));
+        if (!sinks.empty()) sinks.back()->queue.push(std::move(reading));
+    }
+
+    void publish(std::vector<Reading>& readings) {
+        for (auto& reading : readings) publish(std::move(reading));
+        readings.clear();
+    }
+
+    // The priority path: straight onto every sink's urgent queue, waking the sink thread now.
+    void publish_urgent(Reading&& reading) {
+        for (size_t i = 0; i < sinks.size(); ++i) {
+            Sink& sink = *sinks[i];
+            sink.urgent.push(i + 1 < sinks.size() ? Reading(reading) : std::move(reading));
+            {
+                std::lock_guard<std::mutex> lock(sink.wake_mu);
+                sink.woken = true;
+            }
+            sink.wake.notify_one();
+        }
+    }
+
+    void start(const std::atomic<bool>& running, const AgentIdentity& id, std::chrono::milliseconds flush_interval) {
+        for (auto& sink : sinks) {
+            sink->thread = std::thread(&Sink::run, sink.get(), std::cref(running), std::cref(id), flush_interval);
+        }
+    }
+
+    void join() {
+        for (auto& sink : sinks) {
+            if (sink->thread.joinable()) sink->thread.join();
+        }
+    }
+
+    // Every sink is a delta link, so sources may repeat unchanged values.
+    bool all_send_deltas() const {
+        if (sinks.empty()) return false;
+        for (const auto& sink : sinks) {
+            if (!sink->encoder->sends_deltas()) return false;
+        }
+        return true;
+    }
+
+    // One "sink_<name>" reading per sink, so exporter health travels with the data.
+    std::vector<Reading> stats_readings(double interval_seconds) {
+        std::vector<Reading> out;
+        for (auto& sink : sinks) {
+            uint64_t sent = sink->readings_sent.load();
+            Reading reading;
+            reading.sensor_id = "sink_" + sink->name;
+            reading.timestamp = timestamp();
+            reading.values = {
+                {"readings_sent_total", static_cast<double>(sent)},
+                {"readings_sent_rate", interval_seconds > 0 ? (sent - sink->last_sent) / interval_seconds : 0.0},
+                {"readings_dropped_total", static_cast<double>(sink->queue.dropped.load() + sink->urgent.dropped.load())},
+                {"readings_failed_total", static_cast<double>(sink->readings_failed.load())},
+                {"bytes_sent_total", static_cast<double>(sink->bytes_sent.load())},
+            };
+            {
+                std::lock_guard<std::mutex> lock(sink->queue.mu);
+                reading.values.emplace_back("queue_depth", static_cast<double>(sink->queue.queue.size()));
+            }
+            sink->encoder->append_stats(reading.values);
+            sink->last_sent = sent;
+            out.push_back(std::move(reading));
+        }
+        return out;
+    }
+
+    void log_stats() const {
+        for (const auto& sink : sinks) {
+            std::cout << "[STATS] Sink " << sink->name << ": sent " << sink->readings_sent
+                      << ", dropped " << sink->queue.dropped << ", failed " << sink->readings_failed
+                      << ", bytes " << sink->bytes_sent << std::endl;
+        }
+    }
+
+    std::vector<std::unique_ptr<Sink>> sinks;
+};
+
+// Builds one sink from a SINKS entry; nullptr (with an error logged) if it cannot be set up.
+inline std::unique_ptr<Sink> make_sink(const std::string& entry, zmq::context_t& ctx, size_t queue_capacity,
+                                       const ReplyHandler& on_reply = {}) {
+    size_t colon = entry.find(':');
+    std::string kind = entry.substr(0, colon);
+    std::string target = colon == std::string::npos ? "" : entry.substr(colon + 1);
+
+    if (kind == "zmq") {
+        std::string endpoint = target.empty() ? processor_endpoint() : target;
+        // Relaxed REQ with a receive timeout: a lost reply costs one batch, not the sink
+        zmq::socket_t sock = connect_processor(ctx, endpoint, "", true);
+        sock.set(zmq::sockopt::rcvtimeo, 5000);
+        // Wide readings go out as deltas unless DELTA_MIN_VALUES=0
+        auto min_values = static_cast<size_t>(env_long("DELTA_MIN_VALUES", 16));
+        std::unique_ptr<Encoder> encoder;
+        if (min_values > 0) {
+            encoder = std::make_unique<DeltaJsonBatchEncoder>(min_values,
+                                                              static_cast<uint32_t>(env_long("DELTA_KEYFRAME_EVERY", 30)));
+        } else {
+            encoder = std::make_unique<JsonBatchEncoder>();
+        }
+        return std::make_unique<Sink>(kind, std::move(encoder),
+                                      std::make_unique<ZmqWriter>(std::move(sock), on_reply), queue_capacity, 500);
+    }
+    if (kind == "udp") {
+        std::string endpoint = target.empty() ? processor_udp_endpoint() : target;
+        int fd = open_udp_socket(endpoint);
+        if (fd < 0) {
+            std::cerr << "[ERROR] Failed to open UDP sink to " << endpoint << std::endl;
+            return nullptr;
+        }
+        long requested = env_long("UDP_DATAGRAM_BYTES", kUdpDefaultDatagram);
+        auto datagram_size = static_cast<size_t>(std::clamp<long>(requested, 512, kUdpMaxPayload));
+        return std::make_unique<Sink>(kind, std::make_unique<UdpDatagramEncoder>(datagram_size),
+                                      std::make_unique<UdpWriter>(fd), queue_capacity, queue_capacity);
+    }
+    if (kind == "file" && !target.empty()) {
+        return std::make_unique<Sink>(kind, std::make_unique<JsonLinesEncoder>(),
+                                      std::make_unique<FileWriter>(target), queue_capacity, 1000);
+    }
+    if (kind == "influx" && !target.empty()) {
+        return std::make_unique<Sink>(kind, std::make_unique<InfluxLineEncoder>(),
+                                      std::make_unique<TcpWriter>(target), queue_capacity, 1000);
+    }
+    if (kind == "otlp" && !target.empty()) {
+        size_t slash = target.find('/');
+        std::string host_port = target.substr(0, slash);
+        std::string path = slash == std::string::npos ? "/v1/metrics" : target.substr(slash);
+        return std::make_unique<Sink>(kind, std::make_unique<OtlpEncoder>(),
+                                      std::make_unique<HttpPostWriter>(host_port, path, "application/x-protobuf"),
+                                      queue_capacity, 500);
+    }
+    std::cerr << "[ERROR] Unknown or incomplete sink '" << entry << "'" << std::endl;
+    return nullptr;
+}
+
+// Parses SINKS; a kind listed twice gets a numeric suffix ("file", "file_2").
+// on_reply sees every processor reply on the zmq sinks.
+inline SinkSet make_sinks(const std::string& spec, zmq::context_t& ctx, size_t queue_capacity,
+                          const ReplyHandler& on_reply = {}) {
+    SinkSet set;
+    std::map<std::string, int> seen;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string entry = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (entry.empty()) continue;
+        auto sink = make_sink(entry, ctx, queue_capacity, on_reply);
+        if (!sink) continue;
+        int n = ++seen[sink->name];
+        if (n > 1) sink->name += "_" + std::to_string(n);
+        set.sinks.push_back(std::move(sink));
+    }
+    return set;
+}
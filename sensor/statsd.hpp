@@ -0,0 +1,328 @@
+#pragma once
+
+// StatsD line protocol ingest: applications on the host send
+//   <name>:<value>|<c|g|ms|h|d|s>[|@<sample rate>][|#<tags>]
+// over UDP. Datagrams are received in batches with recvmmsg, parsed in place
+// and pre-aggregated per flush interval; only the aggregates are forwarded.
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+enum class StatsdType : uint8_t { counter, gauge, timer, set };
+
+// One parsed line. name points into the datagram buffer; nothing is copied.
+struct StatsdSample {
+    std::string_view name;
+    double value = 0.0;
+    uint64_t member = 0;        // hashed member for sets
+    StatsdType type = StatsdType::counter;
+    double sample_rate = 1.0;
+    bool gauge_delta = false;   // "+n"/"-n" on a gauge adjusts it instead of setting it
+};
+
+inline uint64_t fnv1a(std::string_view s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+inline bool parse_statsd_number(std::string_view text, double& out) {
+    if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+    auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+    return res.ec == std::errc() && res.ptr == text.data() + text.size() && std::isfinite(out);
+}
+
+inline bool parse_statsd_line(std::string_view line, StatsdSample& out) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    size_t colon = line.find(':');
+    size_t bar = line.find('|');
+    if (colon == 0 || colon == std::string_view::npos || bar == std::string_view::npos || bar < colon) return false;
+
+    out.name = line.substr(0, colon);
+    std::string_view value = line.substr(colon + 1, bar - colon - 1);
+    std::string_view rest = line.substr(bar + 1);
+    size_t next = rest.find('|');
+    std::string_view type = rest.substr(0, next);
+    rest = next == std::string_view::npos ? std::string_view() : rest.substr(next + 1);
+
+    if (type == "c") out.type = StatsdType::counter;
+    else if (type == "g") out.type = StatsdType::gauge;
+    else if (type == "ms" || type == "h" || type == "d") out.type = StatsdType::timer;
+    else if (type == "s") out.type = StatsdType::set;
+    else return false;
+
+    out.sample_rate = 1.0;
+    while (!rest.empty()) {
+        next = rest.find('|');
+        std::string_view field = rest.substr(0, next);
+        if (field.size() > 1 && field.front() == '@') {
+            double rate;
+            if (!parse_statsd_number(field.substr(1), rate) || rate <= 0.0 || rate > 1.0) return false;
+            out.sample_rate = rate;
+        }
+        // '#tags' and other extensions are accepted and ignored
+        rest = next == std::string_view::npos ? std::string_view() : rest.substr(next + 1);
+    }
+
+    if (out.type == StatsdType::set) {
+        if (value.empty()) return false;
+        out.member = fnv1a(value);
+        return true;
+    }
+    out.gauge_delta = out.type == StatsdType::gauge && !value.empty() && (value.front() == '+' || value.front() == '-');
+    return parse_statsd_number(value, out.value);
+}
+
+// Aggregation state for one metric name. Slots are created on first sight of a
+// name and reused across intervals, so steady-state ingest does not allocate.
+struct StatsdMetric {
+    std::string name;
+    uint64_t hash = 0;
+    StatsdType type = StatsdType::counter;
+    bool used = false;
+    bool touched = false;
+    double counter = 0.0;
+    double gauge = 0.0;
+    double timer_count = 0.0;   // scaled by sample rate
+    uint64_t timer_seen = 0;    // samples actually received
+    double timer_sum = 0.0;
+    double timer_min = 0.0;
+    double timer_max = 0.0;
+    std::vector<double> timer_samples;
+    std::vector<uint64_t> set_members;
+};
+
+// Open-addressing table of metrics keyed by (name, type). Capacity is fixed up
+// front; names beyond it are counted and dropped rather than growing the table.
+struct StatsdAggregator {
+    static constexpr size_t kTimerSampleCap = 1024;
+
+    explicit StatsdAggregator(size_t max_metrics) {
+        size_t slots = 16;
+        while (slots < max_metrics * 2) slots <<= 1;
+        table.resize(slots);
+        limit = max_metrics;
+    }
+
+    void add(const StatsdSample& sample) {
+        StatsdMetric* m = find_or_insert(sample.name, sample.type);
+        if (!m) return;
+        m->touched = true;
+        switch (sample.type) {
+        case StatsdType::counter:
+            m->counter += sample.value / sample.sample_rate;
+            break;
+        case StatsdType::gauge:
+            m->gauge = sample.gauge_delta ? m->gauge + sample.value : sample.value;
+            break;
+        case StatsdType::timer:
+            if (m->timer_seen == 0) {
+                m->timer_min = m->timer_max = sample.value;
+            } else {
+                m->timer_min = std::min(m->timer_min, sample.value);
+                m->timer_max = std::max(m->timer_max, sample.value);
+            }
+            m->timer_count += 1.0 / sample.sample_rate;
+            m->timer_seen++;
+            m->timer_sum += sample.value;
+            if (m->timer_samples.size() < kTimerSampleCap) {
+                m->timer_samples.push_back(sample.value);
+            } else {
+                // Reservoir sampling keeps the percentiles unbiased past the cap
+                rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+                size_t slot = rng % m->timer_seen;
+                if (slot < kTimerSampleCap) m->timer_samples[slot] = sample.value;
+            }
+            break;
+        case StatsdType::set:
+            if (m->set_members.size() < kTimerSampleCap * 16) m->set_members.push_back(sample.member);
+            break;
+        }
+    }
+
+    // Emits one reading per metric touched since the last flush and resets them.
+    void flush(double interval_seconds, const std::string& ts, std::vector<Reading>& out) {
+        for (auto& m : table) {
+            if (!m.used || !m.touched) continue;
+            Reading reading;
+            reading.sensor_id = "statsd." + m.name;
+            reading.timestamp = ts;
+            switch (m.type) {
+            case StatsdType::counter:
+                reading.values.emplace_back("count", m.counter);
+                reading.values.emplace_back("rate", m.counter / interval_seconds);
+                m.counter = 0.0;
+                break;
+            case StatsdType::gauge:
+                reading.values.emplace_back("value", m.gauge);
+                break;
+            case StatsdType::timer: {
+                auto& v = m.timer_samples;
+                reading.values.emplace_back("count", m.timer_count);
+                reading.values.emplace_back("mean", m.timer_sum / m.timer_seen);
+                reading.values.emplace_back("min", m.timer_min);
+                reading.values.emplace_back("max", m.timer_max);
+                for (auto [key, q] : {std::pair<const char*, double>{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}}) {
+                    size_t idx = std::min(v.size() - 1, static_cast<size_t>(q * v.size()));
+                    std::nth_element(v.begin(), v.begin() + idx, v.end());
+                    reading.values.emplace_back(key, v[idx]);
+                }
+                m.timer_count = m.timer_sum = 0.0;
+                m.timer_seen = 0;
+                v.clear();
+                break;
+            }
+            case StatsdType::set: {
+                auto& v = m.set_members;
+                std::sort(v.begin(), v.end());
+                reading.values.emplace_back("unique", static_cast<double>(std::unique(v.begin(), v.end()) - v.begin()));
+                v.clear();
+                break;
+            }
+            }
+            m.touched = false;
+            out.push_back(std::move(reading));
+        }
+    }
+
+    StatsdMetric* find_or_insert(std::string_view name, StatsdType type) {
+        uint64_t h = fnv1a(name) ^ (static_cast<uint64_t>(type) * 0x9E3779B97F4A7C15ull);
+        size_t mask = table.size() - 1;
+        for (size_t i = h & mask, probes = 0; probes < table.size(); i = (i + 1) & mask, ++probes) {
+            StatsdMetric& m = table[i];
+            if (!m.used) {
+                if (used >= limit) {
+                    dropped_names++;
+                    return nullptr;
+                }
+                m.used = true;
+                m.hash = h;
+                m.type = type;
+                m.name.assign(name.data(), name.size());
+                if (type == StatsdType::timer) m.timer_samples.reserve(kTimerSampleCap);
+                used++;
+                return &m;
+            }
+            if (m.hash == h && m.type == type && m.name == name) return &m;
+        }
+        dropped_names++;
+        return nullptr;
+    }
+
+    std::vector<StatsdMetric> table;
+    size_t used = 0;
+    size_t limit = 0;
+    uint64_t dropped_names = 0;
+    uint64_t rng = 0x2545F4914F6CDD1Dull;
+};
+
+struct StatsdStats {
+    uint64_t packets = 0;
+    uint64_t lines = 0;
+    uint64_t bad_lines = 0;
+    uint64_t truncated = 0;
+};
+
+inline void statsd_consume_datagram(std::string_view data, StatsdAggregator& agg, StatsdStats& stats) {
+    StatsdSample sample;
+    while (!data.empty()) {
+        size_t nl = data.find('\n');
+        std::string_view line = data.substr(0, nl);
+        data = nl == std::string_view::npos ? std::string_view() : data.substr(nl + 1);
+        if (line.empty()) continue;
+        stats.lines++;
+        if (parse_statsd_line(line, sample)) agg.add(sample);
+        else stats.bad_lines++;
+    }
+}
+
+// Receives StatsD datagrams on the given UDP port until running turns false and
+// pushes the aggregates of every flush interval into out.
+inline void statsd_thread(const std::atomic<bool>& running, ReadingQueue& out, uint16_t port,
+                          std::chrono::milliseconds flush_interval, size_t max_metrics) {
+    constexpr size_t kBatch = 256;
+    constexpr size_t kDatagramSize = 4096;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        std::cerr << "[ERROR] StatsD socket failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    timeval tv{0, 100 * 1000};  // wake up regularly to flush and to notice shutdown
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "[ERROR] StatsD bind to port " << port << " failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return;
+    }
+    std::cout << "[INFO] StatsD listener started on UDP port " << port << "." << std::endl;
+
+    std::vector<char> buffers(kBatch * kDatagramSize);
+    std::vector<iovec> iovs(kBatch);
+    std::vector<mmsghdr> msgs(kBatch);
+    for (size_t i = 0; i < kBatch; ++i) {
+        iovs[i] = {buffers.data() + i * kDatagramSize, kDatagramSize};
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    StatsdAggregator agg(max_metrics);
+    StatsdStats stats;
+    std::vector<Reading> flushed;
+    auto last_flush = std::chrono::steady_clock::now();
+
+    while (running) {
+        int n = recvmmsg(fd, msgs.data(), kBatch, MSG_WAITFORONE, nullptr);
+        for (int i = 0; i < n; ++i) {
+            stats.packets++;
+            std::string_view datagram(buffers.data() + i * kDatagramSize, msgs[i].msg_len);
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                // The last line was cut mid-value ("foo:12" of "foo:1234|c"); keep only the complete ones
+                stats.truncated++;
+                size_t nl = datagram.rfind('\n');
+                if (nl == std::string_view::npos) continue;
+                datagram = datagram.substr(0, nl);
+            }
+            statsd_consume_datagram(datagram, agg, stats);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_flush >= flush_interval) {
+            double seconds = std::chrono::duration<double>(now - last_flush).count();
+            flushed.clear();
+            agg.flush(seconds, timestamp(), flushed);
+            for (auto& reading : flushed) out.push(std::move(reading));
+            std::cout << "[STATS] StatsD: " << stats.packets << " packets (" << stats.packets / seconds
+                      << "/s), " << stats.lines << " lines, " << stats.bad_lines << " bad, " << stats.truncated
+                      << " truncated, " << flushed.size() << " metrics flushed, " << agg.dropped_names
+                      << " names over limit" << std::endl;
+            stats = StatsdStats();
+            last_flush = now;
+        }
+    }
+    close(fd);
+    std::cout << "[INFO] StatsD listener exiting." << std::endl;
+}
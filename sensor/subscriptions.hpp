@@ -0,0 +1,121 @@
+#pragma once
+
+// Lazy sampling: sensors run at full rate only while someone downstream is
+// looking at them, and fall back to a heartbeat otherwise so their series stay
+// alive. Interest arrives as leases: the processor's reply to each batch
+// lists the sensor-id globs it currently wants ({"subscriptions": [{"sensor":
+// "cpu_*", "lease_s": 30}]}) and each grant holds for its lease unless renewed.
+// SUBSCRIBE pins globs that are always wanted.
+//
+// With LAZY_SAMPLING unset every sensor is always wanted, which is also the
+// only sensible setting for sinks that cannot answer (file, udp, influx, otlp).
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fnmatch.h>
+#include <nlohmann/json.hpp>
+#include "wire.hpp"
+
+class SubscriptionTable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void configure(bool lazy, std::chrono::milliseconds heartbeat, const std::vector<std::string>& pinned) {
+        std::lock_guard<std::mutex> lock(mu_);
+        lazy_ = lazy;
+        heartbeat_ = heartbeat;
+        for (const auto& glob : pinned) leases_.push_back({glob, Clock::time_point::max()});
+    }
+
+    bool lazy() const { return lazy_; }
+
+    // Grants or renews interest in a glob until now + lease.
+    void grant(const std::string& glob, std::chrono::milliseconds lease) {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mu_);
+        grants_++;
+        auto it = std::find_if(leases_.begin(), leases_.end(), [&](const Lease& l) { return l.glob == glob; });
+        bool was_active = it != leases_.end() && it->expires > now;
+        if (it == leases_.end()) leases_.push_back({glob, now + lease});
+        else it->expires = std::max(it->expires, now + lease);
+        if (was_active) return;
+        std::cout << "[INFO] Subscription to '" << glob << "' granted" << std::endl;
+        changed_.notify_all();
+    }
+
+    // Applies the "subscriptions" of a processor reply; anything else in it is ignored.
+    void apply_reply(const std::string& reply) {
+        if (!lazy_ || reply.find("\"subscriptions\"") == std::string::npos) return;
+        nlohmann::json message = nlohmann::json::parse(reply, nullptr, false);
+        if (!message.is_object() || !message["subscriptions"].is_array()) return;
+        for (const auto& entry : message["subscriptions"]) {
+            if (!entry.is_object() || !entry.contains("sensor") || !entry["sensor"].is_string()) continue;
+            double lease_s = entry.contains("lease_s") && entry["lease_s"].is_number() ? entry["lease_s"].get<double>() : 30.0;
+            grant(entry["sensor"].get<std::string>(), std::chrono::milliseconds(static_cast<long>(lease_s * 1000)));
+        }
+    }
+
+    bool wanted(const std::string& sensor_id) const {
+        if (!lazy_) return true;
+        std::lock_guard<std::mutex> lock(mu_);
+        return wanted_locked(sensor_id, Clock::now());
+    }
+
+    // Sleeps until sensor_id is due again: interval while wanted, the heartbeat
+    // otherwise. A grant arriving meanwhile cuts a heartbeat wait short.
+    void pace(const std::string& sensor_id, std::chrono::milliseconds interval, const std::atomic<bool>& running) {
+        if (wanted(sensor_id)) {
+            std::this_thread::sleep_for(interval);
+            return;
+        }
+        auto due = Clock::now() + heartbeat_;
+        std::unique_lock<std::mutex> lock(mu_);
+        while (running) {
+            auto now = Clock::now();
+            if (now >= due || wanted_locked(sensor_id, now)) return;
+            changed_.wait_until(lock, std::min(due, now + std::chrono::milliseconds(200)));  // also polls running
+        }
+    }
+
+    // "subscriptions": leases in force and grants received.
+    Reading stats_reading() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto now = Clock::now();
+        size_t active = static_cast<size_t>(std::count_if(leases_.begin(), leases_.end(), [&](const Lease& l) { return l.expires > now; }));
+        Reading reading;
+        reading.sensor_id = "subscriptions";
+        reading.timestamp = timestamp();
+        reading.values = {
+            {"leases", static_cast<double>(active)},
+            {"grants_total", static_cast<double>(grants_)},
+        };
+        return reading;
+    }
+
+private:
+    struct Lease {
+        std::string glob;
+        Clock::time_point expires;
+    };
+
+    bool wanted_locked(const std::string& sensor_id, Clock::time_point now) const {
+        for (const Lease& lease : leases_) {
+            if (lease.expires > now && fnmatch(lease.glob.c_str(), sensor_id.c_str(), 0) == 0) return true;
+        }
+        return false;
+    }
+
+    mutable std::mutex mu_;
+    std::condition_variable changed_;
+    bool lazy_ = false;
+    std::chrono::milliseconds heartbeat_{30000};
+    std::vector<Lease> leases_;
+    uint64_t grants_ = 0;
+};
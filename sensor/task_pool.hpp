@@ -0,0 +1,152 @@
+#pragma once
+
+// Work-stealing pool for collectors whose work splits into independent pieces
+// (a range of pids, a mount, a cgroup subtree). Each worker owns a deque: it
+// takes its own tasks from the back and, when it runs dry, steals from the
+// front of the others', so uneven pieces still keep every worker busy.
+//
+//     std::vector<Totals> partial(chunks.size());
+//     pool.parallel_for(chunks.size(), [&](size_t i) { partial[i] = scan(chunks[i]); });
+//     // merge partial into one reading
+//
+// The calling thread runs tasks too while it waits, so a collector never sits
+// idle and a parallel_for from inside a task cannot deadlock the pool.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool {
+public:
+    explicit TaskPool(size_t workers) {
+        workers = std::max<size_t>(workers, 1);
+        for (size_t i = 0; i < workers; ++i) queues_.push_back(std::make_unique<WorkQueue>());
+        for (size_t i = 0; i < workers; ++i) threads_.emplace_back(&TaskPool::worker, this, i);
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mu_);
+            stopping_ = true;
+        }
+        wake_cv_.notify_all();
+        for (auto& thread : threads_) thread.join();
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    size_t size() const { return threads_.size(); }
+
+    // Runs fn(i) for every i in [0, count) and returns once all have finished.
+    template <typename Fn>
+    void parallel_for(size_t count, Fn&& fn) {
+        if (count == 0) return;
+        Group group;
+        group.remaining = count;
+        // Spread the tasks over the deques; stealing evens out whatever this gets wrong
+        size_t start = next_queue_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            WorkQueue& q = *queues_[(start + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(q.mu);
+            q.tasks.push_back({[&fn, i] { fn(i); }, &group});
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mu_);
+            pending_.fetch_add(count, std::memory_order_release);
+        }
+        wake_cv_.notify_all();
+
+        while (group.remaining.load(std::memory_order_acquire) > 0) {
+            if (run_one(start % queues_.size())) continue;
+            std::unique_lock<std::mutex> lock(group.mu);
+            group.cv.wait_for(lock, std::chrono::milliseconds(1),
+                              [&] { return group.remaining.load(std::memory_order_acquire) == 0; });
+        }
+        // The last task decrements under the mutex; taking it once more means no worker still touches group
+        std::lock_guard<std::mutex> lock(group.mu);
+    }
+
+    uint64_t tasks_run() const { return tasks_run_.load(std::memory_order_relaxed); }
+    uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Group {
+        std::atomic<size_t> remaining{0};
+        std::mutex mu;
+        std::condition_variable cv;
+    };
+
+    struct Task {
+        std::function<void()> fn;
+        Group* group;
+    };
+
+    struct WorkQueue {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    // Own deque from the back (most recently pushed, still warm), others' from the front.
+    bool take(size_t home, Task& task) {
+        {
+            WorkQueue& q = *queues_[home];
+            std::lock_guard<std::mutex> lock(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues_.size(); ++k) {
+            WorkQueue& q = *queues_[(home + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool run_one(size_t home) {
+        if (pending_.load(std::memory_order_acquire) == 0) return false;
+        Task task;
+        if (!take(home, task)) return false;
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+        task.fn();
+        tasks_run_.fetch_add(1, std::memory_order_relaxed);
+        Group* group = task.group;
+        std::lock_guard<std::mutex> lock(group->mu);
+        if (group->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) group->cv.notify_all();
+        return true;
+    }
+
+    void worker(size_t index) {
+        while (true) {
+            if (run_one(index)) continue;
+            std::unique_lock<std::mutex> lock(wake_mu_);
+            wake_cv_.wait(lock, [&] { return stopping_ || pending_.load(std::memory_order_acquire) > 0; });
+            if (stopping_) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<uint64_t> tasks_run_{0};
+    std::atomic<uint64_t> steals_{0};
+    std::mutex wake_mu_;
+    std::condition_variable wake_cv_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <zmq.hpp>
+
+// Where the processor's REP socket listens; PROCESSOR_ENDPOINT overrides it.
+inline std::string processor_endpoint() {
+    const char* endpoint = std::getenv("PROCESSOR_ENDPOINT");
+    return endpoint ? endpoint : "tcp://processor:5555";
+}
+
+// REQ socket to the processor. With relaxed set, a request whose reply never
+// came may be abandoned and a new one sent on the same socket.
+inline zmq::socket_t connect_processor(zmq::context_t& ctx, const std::string& endpoint,
+                                       const std::string& routing_id = "", bool relaxed = false) {
+    zmq::socket_t sock(ctx, zmq::socket_type::req);
+    sock.set(zmq::sockopt::linger, 0);
+    if (!routing_id.empty()) sock.set(zmq::sockopt::routing_id, routing_id);
+    if (relaxed) {
+        sock.set(zmq::sockopt::req_relaxed, 1);
+        sock.set(zmq::sockopt::req_correlate, 1);
+    }
+    sock.connect(endpoint);
+    return sock;
+}
+
+// One REQ/REP round trip; false if the processor did not answer. The reply body goes to reply if given.
+inline bool send_to_processor(zmq::socket_t& sock, const std::string& payload, std::string* reply_body = nullptr) {
+    try {
+        sock.send(zmq::buffer(payload), zmq::send_flags::none);
+        zmq::message_t reply;
+        auto ok = sock.recv(reply, zmq::recv_flags::none);
+        if (!ok) {
+            std::cerr << "[WARN] No reply from processor\n";
+            return false;
+        }
+        if (reply_body) reply_body->assign(static_cast<const char*>(reply.data()), reply.size());
+        return true;
+    } catch (const std::exception& ex) {
+        std::cerr << "[ERROR] ZMQ send/recv failed: " << ex.what() << "\n";
+        return false;
+    }
+}
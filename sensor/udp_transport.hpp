@@ -0,0 +1,207 @@
+#pragma once
+
+// Fire-and-forget transport: readings packed into MTU-sized UDP datagrams and
+// sent in batches with sendmmsg. Every datagram carries a 20-byte header in
+// network byte order followed by newline-separated JSON readings:
+//
+//   u32 magic "TLU1" | u16 version | u16 record count | u32 stream id | u64 sequence
+//
+// The stream id is random per sender start, the sequence increments per
+// datagram, so the receiver can count lost and reordered datagrams.
+//
+// A reading too wide for one datagram (per-CPU tables on large hosts) is split
+// by values into several readings with the same sensor id and timestamp, each
+// carrying the reading's "sampled_at"; the processor stores every metric as
+// its own series, so the parts land exactly where the whole would have.
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "wire.hpp"
+
+constexpr uint32_t kUdpMagic = 0x544C5531;  // "TLU1"
+constexpr uint16_t kUdpVersion = 1;
+constexpr size_t kUdpHeaderSize = 20;
+constexpr size_t kUdpDefaultDatagram = 1400;  // stays under a 1500 byte Ethernet MTU with IP/UDP headers
+constexpr size_t kUdpMaxPayload = 65507;       // 65535 less the IPv4 and UDP headers
+
+struct UdpStream {
+    uint32_t stream_id = std::random_device{}();
+    uint64_t next_seq = 0;
+    uint64_t split = 0;     // readings sent as several parts
+    uint64_t oversize = 0;  // parts dropped: a single value that no datagram can hold
+};
+
+// Halves of part's values, each with a copy of "sampled_at" so both stay rate-able.
+inline void split_reading(const Reading& part, Reading& first, Reading& second) {
+    first.sensor_id = second.sensor_id = part.sensor_id;
+    first.timestamp = second.timestamp = part.timestamp;
+    first.data_consistent = second.data_consistent = part.data_consistent;
+    std::vector<const std::pair<std::string, double>*> metrics;
+    for (const auto& value : part.values) {
+        if (value.first == "sampled_at") {
+            first.values.push_back(value);
+            second.values.push_back(value);
+        } else {
+            metrics.push_back(&value);
+        }
+    }
+    for (size_t i = 0; i < metrics.size(); ++i) (i < metrics.size() / 2 ? first : second).values.push_back(*metrics[i]);
+}
+
+inline size_t metric_count(const Reading& reading) {
+    return reading.values.size() -
+           std::count_if(reading.values.begin(), reading.values.end(), [](const auto& v) { return v.first == "sampled_at"; });
+}
+
+inline void put_be(std::string& buf, size_t pos, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        buf[pos + i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+}
+
+inline void finish_datagram(std::string& datagram, UdpStream& stream, uint16_t records) {
+    put_be(datagram, 0, kUdpMagic, 4);
+    put_be(datagram, 4, kUdpVersion, 2);
+    put_be(datagram, 6, records, 2);
+    put_be(datagram, 8, stream.stream_id, 4);
+    put_be(datagram, 12, stream.next_seq++, 8);
+}
+
+// Appends the readings to out as datagrams of at most max_size bytes. A reading
+// too large for one datagram on its own is split until its parts fit; a single
+// value that still does not fit gets a datagram to itself if the kernel can
+// send it at all, and is dropped and counted (stream.oversize) if not, so no
+// sequence number goes to a datagram that can never leave.
+// Records are encoded straight into the datagram and moved on if they overflow it.
+inline void pack_datagrams(UdpStream& stream, const std::vector<Reading>& readings, const AgentIdentity& id,
+                           size_t max_size, std::vector<std::string>& out) {
+    ReadingEncoder& encoder = thread_reading_encoder();
+    std::string datagram(kUdpHeaderSize, '\0');
+    datagram.reserve(max_size);
+    uint16_t records = 0;
+    std::vector<Reading> parts;  // pieces of an oversized reading still to place, next one last
+    // Places one reading; false (and nothing placed) if on its own it would exceed limit
+    auto place = [&](const Reading& reading, size_t limit) {
+        size_t mark = datagram.size();
+        if (records > 0) datagram.push_back('\n');
+        encoder.append(datagram, reading, id);
+        size_t length = datagram.size() - mark - (records > 0 ? 1 : 0);
+        if (kUdpHeaderSize + length > limit) {
+            datagram.resize(mark);
+            return false;
+        }
+        if (records > 0 && (datagram.size() > max_size || records == UINT16_MAX)) {
+            std::string next(kUdpHeaderSize, '\0');
+            next.reserve(max_size);
+            next.append(datagram, mark + 1, std::string::npos);
+            datagram.resize(mark);
+            finish_datagram(datagram, stream, records);
+            out.push_back(std::move(datagram));
+            datagram = std::move(next);
+            records = 0;
+        }
+        records++;
+        return true;
+    };
+    for (const auto& reading : readings) {
+        if (place(reading, max_size)) continue;
+        if (metric_count(reading) > 1) stream.split++;
+        parts.clear();
+        parts.push_back(reading);
+        while (!parts.empty()) {
+            Reading part = std::move(parts.back());
+            parts.pop_back();
+            if (part.values.size() != reading.values.size() && place(part, max_size)) continue;
+            if (metric_count(part) > 1) {
+                Reading first, second;
+                split_reading(part, first, second);
+                parts.push_back(std::move(second));
+                parts.push_back(std::move(first));
+            } else if (!place(part, kUdpMaxPayload)) {
+                stream.oversize++;
+            }
+        }
+    }
+    if (records > 0) {
+        finish_datagram(datagram, stream, records);
+        out.push_back(std::move(datagram));
+    }
+}
+
+// Sends all datagrams with as few sendmmsg calls as possible; returns how many went out.
+// A datagram the kernel refuses (ENOBUFS, ECONNREFUSED after an ICMP error...) is
+// skipped; the receiver sees it as a gap in the sequence.
+inline size_t send_datagrams(int fd, const std::vector<std::string>& datagrams) {
+    constexpr size_t kBatch = 64;
+    mmsghdr msgs[kBatch];
+    iovec iovs[kBatch];
+    size_t pos = 0;
+    size_t sent = 0;
+    while (pos < datagrams.size()) {
+        size_t n = std::min(kBatch, datagrams.size() - pos);
+        for (size_t i = 0; i < n; ++i) {
+            const std::string& d = datagrams[pos + i];
+            iovs[i] = {const_cast<char*>(d.data()), d.size()};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int rc = sendmmsg(fd, msgs, n, 0);
+        if (rc < 0) {
+            if (errno != EINTR) pos++;
+            continue;
+        }
+        pos += rc;
+        sent += rc;
+    }
+    return sent;
+}
+
+// Socket of the given type (SOCK_DGRAM, SOCK_STREAM) connected to "host:port"; -1 on failure.
+inline int open_connected_socket(const std::string& host_port, int socktype) {
+    size_t colon = host_port.rfind(':');
+    if (colon == std::string::npos) return -1;
+    std::string host = host_port.substr(0, colon);
+    std::string port = host_port.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = socktype;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+inline int open_udp_socket(const std::string& host_port) {
+    int fd = open_connected_socket(host_port, SOCK_DGRAM);
+    if (fd >= 0) {
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    }
+    return fd;
+}
+
+// Where the processor's UDP receiver listens; PROCESSOR_UDP overrides it.
+inline std::string processor_udp_endpoint() {
+    const char* endpoint = std::getenv("PROCESSOR_UDP");
+    return endpoint ? endpoint : "processor:5556";
+}
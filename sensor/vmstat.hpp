@@ -0,0 +1,204 @@
+#pragma once
+
+// Paging and scheduler pressure: /proc/vmstat counters turned into rates plus
+// /proc/loadavg, delivered together as one "vmstat" reading per tick.
+//
+// /proc/vmstat has ~200 "key value" lines in a fixed order for a given
+// kernel. The first read maps line numbers to the counters we want (several
+// lines may feed one counter, e.g. pgscan_kswapd + pgscan_direct); later reads
+// only count newlines and parse the numbers on mapped lines, with one cheap
+// length check per mapped line to notice if the layout ever changes.
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reading_queue.hpp"
+#include "wire.hpp"
+
+struct VmstatSample {
+    enum Counter { pgfault, pgmajfault, pswpin, pswpout, pgpgin, pgpgout, pgscan, pgsteal, allocstall, oom_kill, kCounters };
+
+    std::chrono::steady_clock::time_point taken;
+    uint64_t counters[kCounters] = {};
+    double load[3] = {};
+    uint64_t tasks_runnable = 0;
+    uint64_t tasks_total = 0;
+};
+
+// Which counter a /proc/vmstat key feeds, or -1. Only consulted while building the map.
+inline int vmstat_counter_for(std::string_view key) {
+    using S = VmstatSample;
+    static const std::pair<std::string_view, int> exact[] = {
+        {"pgfault", S::pgfault}, {"pgmajfault", S::pgmajfault}, {"pswpin", S::pswpin}, {"pswpout", S::pswpout},
+        {"pgpgin", S::pgpgin}, {"pgpgout", S::pgpgout}, {"oom_kill", S::oom_kill},
+    };
+    for (const auto& [name, counter] : exact) {
+        if (key == name) return counter;
+    }
+    auto ends_with = [&](std::string_view suffix) {
+        return key.size() >= suffix.size() && key.substr(key.size() - suffix.size()) == suffix;
+    };
+    // pgscan_anon/_file (and pgsteal_*) re-split the same pages by type; direct_throttle counts events
+    bool duplicate = ends_with("_anon") || ends_with("_file") || key == "pgscan_direct_throttle";
+    if (key.substr(0, 7) == "pgscan_" && !duplicate) return S::pgscan;
+    if (key.substr(0, 8) == "pgsteal_" && !duplicate) return S::pgsteal;
+    if (key.substr(0, 10) == "allocstall") return S::allocstall;
+    return -1;
+}
+
+class VmstatReader {
+public:
+    VmstatReader(const char* vmstat = "/proc/vmstat", const char* loadavg = "/proc/loadavg")
+        : vmstat_fd_(open(vmstat, O_RDONLY | O_CLOEXEC)), loadavg_fd_(open(loadavg, O_RDONLY | O_CLOEXEC)),
+          buf_(16384) {}
+    ~VmstatReader() {
+        if (vmstat_fd_ >= 0) close(vmstat_fd_);
+        if (loadavg_fd_ >= 0) close(loadavg_fd_);
+    }
+    VmstatReader(const VmstatReader&) = delete;
+    VmstatReader& operator=(const VmstatReader&) = delete;
+
+    bool read(VmstatSample& out) {
+        std::string_view text = read_file(vmstat_fd_);
+        if (text.empty()) return false;
+        out.taken = std::chrono::steady_clock::now();
+        parse(text, out);
+        read_loadavg(out);
+        return true;
+    }
+
+    // Counters from /proc/vmstat text, rebuilding the line map when it does not fit.
+    void parse(std::string_view text, VmstatSample& out) {
+        if (map_.empty() || !parse_mapped(text, out)) {
+            build_map(text);
+            parse_mapped(text, out);
+        }
+    }
+
+private:
+    // Line number -> counter, plus the key length so the value starts at key_len + 1
+    struct Mapped {
+        uint32_t line;
+        uint16_t key_len;
+        uint8_t counter;
+    };
+
+    std::string_view read_file(int fd) {
+        if (fd < 0) return {};
+        ssize_t n;
+        while ((n = pread(fd, buf_.data(), buf_.size(), 0)) == static_cast<ssize_t>(buf_.size())) {
+            buf_.resize(buf_.size() * 2);
+        }
+        return n > 0 ? std::string_view(buf_.data(), static_cast<size_t>(n)) : std::string_view();
+    }
+
+    void build_map(std::string_view text) {
+        map_.clear();
+        uint32_t line = 0;
+        while (!text.empty()) {
+            size_t nl = text.find('\n');
+            std::string_view row = text.substr(0, nl);
+            text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+            size_t space = row.find(' ');
+            if (space != std::string_view::npos) {
+                int counter = vmstat_counter_for(row.substr(0, space));
+                if (counter >= 0) {
+                    map_.push_back({line, static_cast<uint16_t>(space), static_cast<uint8_t>(counter)});
+                }
+            }
+            line++;
+        }
+    }
+
+    // False if a mapped line no longer has its key where expected (layout changed).
+    bool parse_mapped(std::string_view text, VmstatSample& out) {
+        for (auto& c : out.counters) c = 0;
+        const char* p = text.data();
+        const char* end = p + text.size();
+        uint32_t line = 0;
+        for (const Mapped& m : map_) {
+            for (; line < m.line; ++line) {
+                p = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                if (!p) return false;
+                ++p;
+            }
+            if (end - p <= m.key_len || p[m.key_len] != ' ') return false;
+            uint64_t value = 0;
+            std::from_chars(p + m.key_len + 1, end, value);
+            out.counters[m.counter] += value;
+        }
+        return true;
+    }
+
+    void read_loadavg(VmstatSample& out) {
+        // "0.19 0.25 0.24 2/71 7540"
+        std::string_view text = read_file(loadavg_fd_);
+        const char* p = text.data();
+        const char* end = p + text.size();
+        for (double& load : out.load) {
+            auto res = std::from_chars(p, end, load);
+            p = res.ptr;
+            while (p < end && *p == ' ') ++p;
+        }
+        auto res = std::from_chars(p, end, out.tasks_runnable);
+        if (res.ptr < end && *res.ptr == '/') std::from_chars(res.ptr + 1, end, out.tasks_total);
+    }
+
+    int vmstat_fd_;
+    int loadavg_fd_;
+    std::vector<char> buf_;
+    std::vector<Mapped> map_;  // sorted by line
+};
+
+inline Reading vmstat_reading(const VmstatSample& prev, const VmstatSample& cur) {
+    using S = VmstatSample;
+    Reading reading;
+    reading.sensor_id = "vmstat";
+    reading.timestamp = timestamp();
+    double seconds = std::chrono::duration<double>(cur.taken - prev.taken).count();
+    auto delta = [&](int c) { return cur.counters[c] >= prev.counters[c] ? cur.counters[c] - prev.counters[c] : 0; };
+    auto rate = [&](int c) { return seconds > 0 ? delta(c) / seconds : 0.0; };
+    reading.values = {
+        {"page_faults_per_sec", rate(S::pgfault)},
+        {"major_faults_per_sec", rate(S::pgmajfault)},
+        {"swap_in_pages_per_sec", rate(S::pswpin)},
+        {"swap_out_pages_per_sec", rate(S::pswpout)},
+        {"page_in_kb_per_sec", rate(S::pgpgin)},
+        {"page_out_kb_per_sec", rate(S::pgpgout)},
+        {"pages_scanned_per_sec", rate(S::pgscan)},
+        {"pages_reclaimed_per_sec", rate(S::pgsteal)},
+        {"allocation_stalls_per_sec", rate(S::allocstall)},
+        {"oom_kills", static_cast<double>(delta(S::oom_kill))},
+        {"load_1m", cur.load[0]},
+        {"load_5m", cur.load[1]},
+        {"load_15m", cur.load[2]},
+        {"tasks_runnable", static_cast<double>(cur.tasks_runnable)},
+        {"tasks_total", static_cast<double>(cur.tasks_total)},
+    };
+    return reading;
+}
+
+inline void vmstat_thread(const std::atomic<bool>& running, ReadingQueue& out, std::chrono::milliseconds interval) {
+    std::cout << "[INFO] vmstat sensor thread started." << std::endl;
+    VmstatReader reader;
+    VmstatSample prev, cur;
+    if (!reader.read(prev)) {
+        std::cerr << "[ERROR] Cannot read /proc/vmstat; vmstat sensor disabled" << std::endl;
+        return;
+    }
+    while (running) {
+        std::this_thread::sleep_for(interval);
+        if (!reader.read(cur)) continue;
+        out.push(vmstat_reading(prev, cur));
+        prev = cur;
+    }
+    std::cout << "[INFO] vmstat sensor thread exiting." << std::endl;
+}
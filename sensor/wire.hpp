@@ -0,0 +1,269 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+#include "json_writer.hpp"
+
+// One reading as it travels to the processor: a sensor id, a timestamp and
+// one or more named values (e.g. "cpu_usage_percent").
+struct Reading {
+    std::string sensor_id;
+    std::string timestamp;
+    std::vector<std::pair<std::string, double>> values;
+    bool data_consistent = true;
+};
+
+// Who is sending: attached to every message so the processor can tell agents apart.
+struct AgentIdentity {
+    std::string host;
+    std::vector<std::pair<std::string, std::string>> labels;
+};
+
+inline std::string timestamp() {
+    std::time_t now = std::time(nullptr);
+    char buf[100];
+    std::strftime(buf, sizeof(buf), "%FT%TZ", std::gmtime(&now));
+    return std::string(buf);
+}
+
+// Monotonic seconds (since boot, on Linux) with sub-second precision. Raw
+// counter readings (COUNTER_MODE=raw) carry it as "sampled_at" so rates
+// downstream divide by the real interval rather than by arrival times; unlike
+// the wall clock it never steps under NTP, and it only goes back at a reboot,
+// where the counters restart too.
+inline double sampled_at_now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Host comes from SENSOR_HOST or the hostname; labels from SENSOR_LABELS ("rack=r1,dc=eu").
+inline AgentIdentity agent_identity_from_env() {
+    AgentIdentity id;
+    if (const char* host = std::getenv("SENSOR_HOST")) {
+        id.host = host;
+    } else {
+        char buf[256] = {0};
+        if (gethostname(buf, sizeof(buf) - 1) == 0) id.host = buf;
+    }
+    if (const char* labels = std::getenv("SENSOR_LABELS")) {
+        std::string spec(labels);
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t end = spec.find(',', pos);
+            if (end == std::string::npos) end = spec.size();
+            std::string item = spec.substr(pos, end - pos);
+            size_t eq = item.find('=');
+            if (eq != std::string::npos && eq > 0) id.labels.emplace_back(item.substr(0, eq), item.substr(eq + 1));
+            pos = end + 1;
+        }
+    }
+    return id;
+}
+
+// JSON object understood by processor.py: reading values become top-level keys.
+// Reference encoding; the wire path uses ReadingEncoder, which emits the same bytes.
+inline nlohmann::json reading_json(const Reading& reading, const AgentIdentity& id) {
+    nlohmann::json message = {
+        {"sensor_id", reading.sensor_id},
+        {"timestamp", reading.timestamp},
+        {"data_consistent", reading.data_consistent}
+    };
+    for (const auto& [key, value] : reading.values) message[key] = value;
+    if (!id.host.empty()) message["host"] = id.host;
+    if (!id.labels.empty()) {
+        nlohmann::json labels = nlohmann::json::object();
+        for (const auto& [key, value] : id.labels) labels[key] = value;
+        message["labels"] = labels;
+    }
+    return message;
+}
+
+// Streams readings as JSON into a reusable buffer, byte for byte what
+// reading_json(...).dump() produces. The first reading of each shape (sensor id
+// plus value names) is turned into a layout: the members in nlohmann's sorted
+// order with every constant part (braces, keys, the sensor id) pre-rendered, so
+// later readings only fill in the timestamp, the flag, the identity and the numbers.
+// Not thread-safe; keep one per sending thread.
+class ReadingEncoder {
+public:
+    void append(std::string& out, const Reading& reading, const AgentIdentity& id) {
+        refresh_identity(id);
+        const Layout& layout = layout_for(reading);
+        for (const Piece& piece : layout.pieces) {
+            out += piece.literal;
+            switch (piece.slot) {
+                case kTimestamp: json_append_string(out, reading.timestamp); break;
+                case kConsistent: out += reading.data_consistent ? "true" : "false"; break;
+                case kHost: out += host_json_; break;
+                case kLabels: out += labels_json_; break;
+                default: json_append_double(out, reading.values[piece.slot].second);
+            }
+        }
+        out += layout.tail;
+    }
+
+    void append_batch(std::string& out, const std::vector<Reading>& readings, const AgentIdentity& id) {
+        out.push_back('[');
+        for (size_t i = 0; i < readings.size(); ++i) {
+            if (i > 0) out.push_back(',');
+            append(out, readings[i], id);
+        }
+        out.push_back(']');
+    }
+
+private:
+    enum Slot : int { kTimestamp = -1, kConsistent = -2, kHost = -3, kLabels = -4 };  // >= 0: index into values
+    static constexpr size_t kMaxLayouts = 4096;   // sensor ids
+    static constexpr size_t kMaxShapes = 8;       // layouts per sensor id
+    static constexpr uint32_t kShapeWindow = 64;  // readings per churn verdict
+
+    struct Piece {
+        std::string literal;
+        int slot;
+    };
+
+    struct Layout {
+        std::vector<std::string> keys;
+        bool host = false;
+        bool labels = false;
+        std::vector<Piece> pieces;
+        std::string tail;
+    };
+
+    struct Shapes {
+        std::vector<Layout> layouts;
+        size_t next_victim = 0;
+        Layout uncached;        // last layout built while churning, not cached
+        uint32_t seen = 0;      // readings in the current window
+        uint32_t misses = 0;
+        bool churning = false;
+    };
+
+    bool matches(const Layout& layout, const Reading& reading) const {
+        if (layout.host != !host_json_.empty() || layout.labels != !labels_json_.empty()) return false;
+        if (layout.keys.size() != reading.values.size()) return false;
+        for (size_t i = 0; i < layout.keys.size(); ++i) {
+            if (layout.keys[i] != reading.values[i].first) return false;
+        }
+        return true;
+    }
+
+    // A sensor keeps at most kMaxShapes layouts, replaced round-robin. One whose
+    // readings mostly missed over the last kShapeWindow (random key sets) stops
+    // caching: each miss builds a throwaway layout and keeps only the last one.
+    const Layout& layout_for(const Reading& reading) {
+        auto it = layouts_.find(reading.sensor_id);
+        if (it == layouts_.end()) {
+            if (layouts_.size() >= kMaxLayouts) layouts_.clear();  // unbounded sensor ids: start over
+            it = layouts_.emplace(reading.sensor_id, Shapes{}).first;
+        }
+        Shapes& shapes = it->second;
+        if (++shapes.seen >= kShapeWindow) {
+            shapes.churning = shapes.misses > kShapeWindow / 2;
+            shapes.seen = shapes.misses = 0;
+        }
+        for (const Layout& layout : shapes.layouts) {
+            if (matches(layout, reading)) return layout;
+        }
+        if (!shapes.uncached.pieces.empty() && matches(shapes.uncached, reading)) return shapes.uncached;
+        shapes.misses++;
+        if (shapes.churning) {
+            shapes.uncached = build_layout(reading);
+            return shapes.uncached;
+        }
+        if (shapes.layouts.size() < kMaxShapes) {
+            shapes.layouts.push_back(build_layout(reading));
+            return shapes.layouts.back();
+        }
+        Layout& victim = shapes.layouts[shapes.next_victim];
+        shapes.next_victim = (shapes.next_victim + 1) % kMaxShapes;
+        victim = build_layout(reading);
+        return victim;
+    }
+
+    // Same assignment order as reading_json, so later members override earlier ones the same way.
+    Layout build_layout(const Reading& reading) const {
+        Layout layout;
+        layout.host = !host_json_.empty();
+        layout.labels = !labels_json_.empty();
+        std::map<std::string, std::pair<int, std::string>> members;  // slot, or a rendered constant
+        std::string sensor_id;
+        json_append_string(sensor_id, reading.sensor_id);
+        members["sensor_id"] = {0, sensor_id};
+        members["timestamp"] = {kTimestamp, ""};
+        members["data_consistent"] = {kConsistent, ""};
+        for (size_t i = 0; i < reading.values.size(); ++i) {
+            layout.keys.push_back(reading.values[i].first);
+            members[reading.values[i].first] = {static_cast<int>(i), ""};
+        }
+        if (layout.host) members["host"] = {kHost, ""};
+        if (layout.labels) members["labels"] = {kLabels, ""};
+
+        std::string literal = "{";
+        bool first = true;
+        for (const auto& [key, member] : members) {
+            if (!first) literal.push_back(',');
+            first = false;
+            json_append_key(literal, key);
+            if (!member.second.empty()) {
+                literal += member.second;
+            } else {
+                layout.pieces.push_back({literal, member.first});
+                literal.clear();
+            }
+        }
+        layout.tail = literal + "}";
+        return layout;
+    }
+
+    void refresh_identity(const AgentIdentity& id) {
+        if (id.host == identity_.host && id.labels == identity_.labels && identity_valid_) return;
+        identity_ = id;
+        identity_valid_ = true;
+        host_json_.clear();
+        labels_json_.clear();
+        if (!id.host.empty()) json_append_string(host_json_, id.host);
+        if (!id.labels.empty()) {
+            std::map<std::string, std::string> sorted;
+            for (const auto& [key, value] : id.labels) sorted[key] = value;
+            labels_json_ = "{";
+            for (const auto& [key, value] : sorted) {
+                if (labels_json_.size() > 1) labels_json_.push_back(',');
+                json_append_key(labels_json_, key);
+                json_append_string(labels_json_, value);
+            }
+            labels_json_ += "}";
+        }
+    }
+
+    std::unordered_map<std::string, Shapes> layouts_;
+    AgentIdentity identity_;
+    bool identity_valid_ = false;
+    std::string host_json_;
+    std::string labels_json_;
+};
+
+inline ReadingEncoder& thread_reading_encoder() {
+    thread_local ReadingEncoder encoder;
+    return encoder;
+}
+
+inline std::string encode_reading(const Reading& reading, const AgentIdentity& id) {
+    std::string out;
+    thread_reading_encoder().append(out, reading, id);
+    return out;
+}
+
+// Several readings in one message: a JSON array of reading objects.
+inline std::string encode_batch(const std::vector<Reading>& readings, const AgentIdentity& id) {
+    std::string out;
+    thread_reading_encoder().append_batch(out, readings, id);
+    return out;
+}